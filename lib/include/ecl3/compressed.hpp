@@ -0,0 +1,96 @@
+#ifndef ECL3_COMPRESSED_HPP
+#define ECL3_COMPRESSED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <ecl3/common.h>
+#include <ecl3/io.hpp>
+
+namespace ecl3 {
+
+enum class compression {
+    none,
+    gzip,
+    zstd,
+};
+
+/*
+ * A stream backend that transparently decompresses gzip and zstd files. The
+ * format is picked from the magic bytes at the start of the file, and files
+ * that are not compressed are read as-is, so this can be used for any file:
+ *
+ *  stream_reader< compressed_stream > fs("CASE.UNSMRY.gz");
+ *
+ * Decompression is streaming, with bounded memory, and never goes through a
+ * temporary file. Concatenated gzip members and zstd frames are read as one
+ * stream.
+ *
+ * Compressed streams cannot skip without decompressing, so they report
+ * themselves as not seekable, and stream_reader drains skipped bodies.
+ * seek() works, but seeking backwards restarts decompression from the start
+ * of the file.
+ *
+ * Support for each format is optional, and decided when ecl3 is built.
+ * Opening a file compressed with an unsupported format throws
+ * std::invalid_argument. Use supports() to check up front.
+ */
+class ECL3_API compressed_stream {
+public:
+    compressed_stream();
+    ~compressed_stream();
+
+    compressed_stream(const compressed_stream&) = delete;
+    compressed_stream& operator=(const compressed_stream&) = delete;
+
+    void open(const std::string& path);
+
+    std::size_t read(char* dst, std::size_t n);
+    bool seekable() const noexcept (true);
+    void skip(std::uint64_t n);
+    std::uint64_t tell() const noexcept (true);
+    void seek(std::uint64_t offset);
+
+    /* The compression of the open file */
+    compression format() const noexcept (true);
+
+    /* Returns true if this build of ecl3 can read the format */
+    static bool supports(compression format) noexcept (true);
+
+private:
+    struct impl;
+    std::unique_ptr< impl > p;
+};
+
+template <>
+struct stream_traits< compressed_stream > {
+    static void open(compressed_stream& s, const std::string& path) {
+        s.open(path);
+    }
+
+    static std::size_t read(compressed_stream& s, char* dst, std::size_t n) {
+        return s.read(dst, n);
+    }
+
+    static bool seekable(compressed_stream& s) noexcept (true) {
+        return s.seekable();
+    }
+
+    static void skip(compressed_stream& s, std::uint64_t n) {
+        s.skip(n);
+    }
+
+    static std::uint64_t tell(compressed_stream& s) noexcept (true) {
+        return s.tell();
+    }
+
+    static void seek(compressed_stream& s, std::uint64_t offset) {
+        s.seek(offset);
+    }
+};
+
+}
+
+#endif // ECL3_COMPRESSED_HPP
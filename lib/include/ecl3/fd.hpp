@@ -0,0 +1,246 @@
+#ifndef ECL3_FD_HPP
+#define ECL3_FD_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <ciso646>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <ecl3/io.hpp>
+
+namespace ecl3 {
+
+/*
+ * A stream backend for stream_reader on POSIX file descriptors, without the
+ * iostreams layer. Reads go through a single caller-sized buffer, and a read
+ * that does not fit in the buffered bytes is a readv() straight into the
+ * destination, which tops up the buffer in the same system call. End-of-file
+ * is reported by short reads, never by exceptions - only actual I/O errors,
+ * and skipping past the end of a truncated file, throw.
+ *
+ * For workloads with many small files the buffer should be at least as large
+ * as a typical file, so that each file is read with a single system call.
+ *
+ * An already-open descriptor, e.g. a pipe or socket, can be read by passing
+ * it instead of a path. The descriptor is then not owned, and is not closed
+ * by the reader. Reading starts at its current position.
+ *
+ * Example
+ * -------
+ *  stream_reader< fd_stream > fs(path, 4 * 1024 * 1024);
+ *  stream_reader< fd_stream > in(STDIN_FILENO);
+ */
+class fd_stream {
+public:
+    static constexpr std::size_t default_buffer_size = 1024 * 1024;
+
+    fd_stream() = default;
+    ~fd_stream();
+
+    fd_stream(const fd_stream&) = delete;
+    fd_stream& operator=(const fd_stream&) = delete;
+
+    void open(const std::string& path,
+              std::size_t buffer_size = default_buffer_size);
+    void open(int fd, std::size_t buffer_size = default_buffer_size);
+
+    std::size_t read(char* dst, std::size_t n);
+    bool seekable() const noexcept (true);
+    void skip(std::uint64_t n);
+    std::uint64_t tell() const noexcept (true);
+    void seek(std::uint64_t offset);
+
+private:
+    int fd = -1;
+    bool owned = false;
+    uninitialized_vector< char > buffer;
+    /* the buffered, not yet consumed bytes are [head, tail) */
+    std::size_t head = 0;
+    std::size_t tail = 0;
+    /* the file offset of the kernel, i.e. of buffer[tail] */
+    std::uint64_t offset = 0;
+
+    [[noreturn]] void fail(const char* what) const;
+    void attach(int fd, bool owned, std::size_t buffer_size);
+};
+
+template <>
+struct stream_traits< fd_stream > {
+    static void open(fd_stream& s, const std::string& path) {
+        s.open(path);
+    }
+
+    static void open(fd_stream& s,
+                     const std::string& path,
+                     std::size_t buffer_size) {
+        s.open(path, buffer_size);
+    }
+
+    static void open(fd_stream& s, int fd) {
+        s.open(fd);
+    }
+
+    static void open(fd_stream& s, int fd, std::size_t buffer_size) {
+        s.open(fd, buffer_size);
+    }
+
+    static std::size_t read(fd_stream& s, char* dst, std::size_t n) {
+        return s.read(dst, n);
+    }
+
+    static bool seekable(fd_stream& s) noexcept (true) {
+        return s.seekable();
+    }
+
+    static void skip(fd_stream& s, std::uint64_t n) {
+        s.skip(n);
+    }
+
+    static std::uint64_t tell(fd_stream& s) noexcept (true) {
+        return s.tell();
+    }
+
+    static void seek(fd_stream& s, std::uint64_t offset) {
+        s.seek(offset);
+    }
+};
+
+inline fd_stream::~fd_stream() {
+    if (this->owned)
+        ::close(this->fd);
+}
+
+inline void fd_stream::open(const std::string& path, std::size_t bufsize) {
+    if (bufsize == 0)
+        throw std::invalid_argument("buffer size must be positive");
+
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        const auto msg = "could not open file '" + path + "'";
+        throw std::invalid_argument(msg);
+    }
+
+    this->attach(fd, true, bufsize);
+}
+
+inline void fd_stream::open(int fd, std::size_t bufsize) {
+    if (bufsize == 0)
+        throw std::invalid_argument("buffer size must be positive");
+    if (fd < 0)
+        throw std::invalid_argument("invalid file descriptor");
+
+    this->attach(fd, false, bufsize);
+}
+
+inline void fd_stream::attach(int fd, bool owned, std::size_t bufsize) {
+    /* re-opening replaces the descriptor, so close the one owned already */
+    if (this->owned)
+        ::close(this->fd);
+
+    this->fd = fd;
+    this->owned = owned;
+    this->head = this->tail = 0;
+
+    /* tell() is relative to the start of the file, if there is one */
+    const auto pos = ::lseek(fd, 0, SEEK_CUR);
+    this->offset = pos == -1 ? 0 : std::uint64_t(pos);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    /* only a hint, and fails harmlessly on pipes */
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    this->buffer.resize(bufsize);
+}
+
+inline std::size_t fd_stream::read(char* dst, std::size_t n) {
+    const auto buffered = std::min(n, this->tail - this->head);
+    std::memcpy(dst, this->buffer.data() + this->head, buffered);
+    this->head += buffered;
+
+    std::size_t done = buffered;
+    while (done < n) {
+        /* the buffer is drained, so refill it while reading the rest */
+        iovec iov[2];
+        iov[0].iov_base = dst + done;
+        iov[0].iov_len  = n - done;
+        iov[1].iov_base = this->buffer.data();
+        iov[1].iov_len  = this->buffer.size();
+
+        const auto r = ::readv(this->fd, iov, 2);
+        if (r == -1 and errno == EINTR) continue;
+        if (r == -1) this->fail("unable to read");
+        if (r == 0) break;
+
+        const auto got = std::size_t(r);
+        this->offset += got;
+        if (got <= n - done) {
+            done += got;
+            continue;
+        }
+
+        this->head = 0;
+        this->tail = got - (n - done);
+        done = n;
+    }
+
+    return done;
+}
+
+inline bool fd_stream::seekable() const noexcept (true) {
+    return ::lseek(this->fd, 0, SEEK_CUR) != -1;
+}
+
+inline void fd_stream::skip(std::uint64_t n) {
+    const auto buffered = this->tail - this->head;
+    if (n <= buffered) {
+        this->head += std::size_t(n);
+        return;
+    }
+
+    const auto rest = off_t(n - buffered);
+    const auto pos = ::lseek(this->fd, rest, SEEK_CUR);
+    if (pos == -1) this->fail("unable to seek forward");
+
+    this->head = this->tail = 0;
+    this->offset = std::uint64_t(pos);
+
+    /*
+     * lseek() moves past the end of a file without complaint, but skipping
+     * past end-of-file means the file is truncated
+     */
+    struct stat st;
+    const auto regular = ::fstat(this->fd, &st) == 0 and S_ISREG(st.st_mode);
+    if (regular and pos > st.st_size)
+        throw std::runtime_error("unexpected end-of-file while skipping");
+}
+
+inline std::uint64_t fd_stream::tell() const noexcept (true) {
+    return this->offset - (this->tail - this->head);
+}
+
+inline void fd_stream::seek(std::uint64_t off) {
+    const auto pos = ::lseek(this->fd, off_t(off), SEEK_SET);
+    if (pos == -1) this->fail("unable to seek");
+
+    this->head = this->tail = 0;
+    this->offset = std::uint64_t(pos);
+}
+
+inline void fd_stream::fail(const char* what) const {
+    throw std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+}
+
+#endif // ECL3_FD_HPP
@@ -1,11 +1,26 @@
 #ifndef ECL3_IO_HPP
 #define ECL3_IO_HPP
 
+#include <algorithm>
 #include <array>
+#include <ciso646>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <ecl3/keyword.h>
+#include <ecl3/thread_pool.hpp>
 
 namespace ecl3 {
 
@@ -19,6 +34,127 @@ struct invalid_type : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+/*
+ * An allocator that default-initializes, i.e. leaves trivial types like char
+ * uninitialized, instead of value-initializing (zeroing) them. Buffers that
+ * are resized only to be immediately overwritten by a read or decode do not
+ * need to be cleared first.
+ */
+template < typename T >
+struct uninitialized_allocator : public std::allocator< T > {
+    template < typename U >
+    struct rebind { using other = uninitialized_allocator< U >; };
+
+    uninitialized_allocator() = default;
+    template < typename U >
+    uninitialized_allocator(const uninitialized_allocator< U >&)
+        noexcept (true) {}
+
+    template < typename U >
+    void construct(U* p)
+    noexcept (std::is_nothrow_default_constructible< U >::value) {
+        ::new (static_cast< void* >(p)) U;
+    }
+
+    template < typename U, typename... Args >
+    void construct(U* p, Args&&... args)
+    noexcept (std::is_nothrow_constructible< U, Args... >::value) {
+        ::new (static_cast< void* >(p)) U(std::forward< Args >(args)...);
+    }
+};
+
+template < typename T >
+using uninitialized_vector = std::vector< T, uninitialized_allocator< T > >;
+
+namespace {
+
+/*
+ * Pack up to 8 characters of kw, padded with spaces, with kw[i] in byte i
+ * (counting from the least significant)
+ */
+constexpr std::uint64_t pack_keyword(const char* kw,
+                                     std::size_t len,
+                                     std::size_t i = 0) noexcept (true) {
+    return i == 8 ? 0 :
+        std::uint64_t(static_cast< unsigned char >(i < len ? kw[i] : ' '))
+            << (8 * i)
+        | pack_keyword(kw, len, i + 1)
+    ;
+}
+
+}
+
+/*
+ * A keyword packed into a single 64-bit integer, so that comparing keywords
+ * is one integer compare. Tokens are made from keywords as they are on disk,
+ * or from shorter literals, which are padded with spaces like the keywords
+ * in the file, so
+ *
+ *  x.token == keyword_token("SEQHDR")
+ *
+ * matches 'SEQHDR  ', and can be evaluated at compile time. The packing is
+ * the same as ecl3_keyword_token in the C API, and the integer value can be
+ * stored and passed around.
+ */
+class keyword_token {
+public:
+    constexpr keyword_token() noexcept (true) : value(pack_keyword("", 0)) {}
+
+    template < std::size_t N >
+    constexpr keyword_token(const char (&kw)[N]) noexcept (true) :
+        value(pack_keyword(kw, N - 1))
+    {
+        static_assert(N <= 9, "keywords are at most 8 characters");
+    }
+
+    explicit keyword_token(const std::array< char, 8 >& kw) noexcept (true) :
+        value(pack_keyword(kw.data(), kw.size()))
+    {}
+
+    /* throws std::invalid_argument for keywords longer than 8 characters */
+    static keyword_token from_string(const std::string& kw);
+
+    static constexpr keyword_token from_int(std::uint64_t x) noexcept (true) {
+        return keyword_token(x, 0);
+    }
+
+    constexpr std::uint64_t get() const noexcept (true) { return this->value; }
+
+    /* The keyword, with padding */
+    std::string str() const;
+
+    constexpr bool operator==(keyword_token o) const noexcept (true) {
+        return this->value == o.value;
+    }
+
+    constexpr bool operator!=(keyword_token o) const noexcept (true) {
+        return this->value != o.value;
+    }
+
+private:
+    constexpr keyword_token(std::uint64_t x, int) noexcept (true) :
+        value(x)
+    {}
+
+    std::uint64_t value;
+};
+
+inline keyword_token keyword_token::from_string(const std::string& kw) {
+    if (kw.size() > 8) {
+        const auto msg = "keyword '" + kw + "' longer than 8 characters";
+        throw std::invalid_argument(msg);
+    }
+
+    return keyword_token::from_int(pack_keyword(kw.data(), kw.size()));
+}
+
+inline std::string keyword_token::str() const {
+    std::string kw(8, ' ');
+    for (std::size_t i = 0; i < 8; ++i)
+        kw[i] = char((this->value >> (8 * i)) & 0xFF);
+    return kw;
+}
+
 struct raw_array {
     /*
      * These are really strings, but the ecl3 C API writes data through
@@ -28,12 +164,241 @@ struct raw_array {
      */
     std::array< char, 8 > keyword;
     std::array< char, 4 > type;
-    int count = 0;
-    std::vector< unsigned char > body;
+    std::int64_t count = 0;
+    /* The keyword as a token, for fast comparisons */
+    keyword_token token;
+    /*
+     * The body is only cleared between arrays, and never shrunk, so once
+     * it has grown to fit the largest array, reading does not allocate.
+     */
+    uninitialized_vector< unsigned char > body;
 
     bool empty() const { return this->count == -1; }
 };
 
+/*
+ * The operations stream_reader needs from any std::istream-like type. The
+ * default stream_traits, and the traits for istream_ref, are built on these.
+ */
+template < typename Stream >
+struct istream_traits {
+    /*
+     * Read up to n bytes into dst, and return the number of bytes read. Fewer
+     * than n bytes is only returned on end-of-file.
+     */
+    static std::size_t read(Stream& s, char* dst, std::size_t n) {
+        s.read(dst, std::streamsize(n));
+        return std::size_t(s.gcount());
+    }
+
+    /*
+     * Returns true if the stream supports skip(), tell() and seek(). This
+     * is called once before the first skip, and pipes should return false.
+     * tellg() fails without setting any error bits on streams that cannot
+     * seek, so use it to probe.
+     */
+    static bool seekable(Stream& s) {
+        return s.tellg() != typename Stream::pos_type(-1);
+    }
+
+    /*
+     * Move n bytes forward. Skipping past end-of-file means the file is
+     * truncated, and throws std::runtime_error, just like draining the bytes
+     * of a pipe would. Seeking past the end succeeds, so the last skipped
+     * byte is read to detect it.
+     */
+    static void skip(Stream& s, std::uint64_t n) {
+        if (n == 0) return;
+
+        s.seekg(std::streamoff(n - 1), Stream::cur);
+        if (s.fail())
+            throw std::runtime_error("unable to seek forward");
+
+        char last;
+        s.read(&last, 1);
+        if (s.gcount() != 1)
+            throw std::runtime_error("unexpected end-of-file while skipping");
+    }
+
+    static std::uint64_t tell(Stream& s) {
+        return std::uint64_t(s.tellg());
+    }
+
+    static void seek(Stream& s, std::uint64_t offset) {
+        s.clear();
+        s.seekg(std::streamoff(offset));
+        if (s.fail())
+            throw std::runtime_error("unable to seek");
+    }
+};
+
+template < typename Stream >
+struct stream_traits : istream_traits< Stream > {
+    /*
+     * Open the stream, and throw std::invalid_argument if it cannot be
+     * opened. The arguments to the stream_reader constructor are forwarded
+     * here.
+     */
+    static void open(Stream& s, const std::string& path) {
+        s.open(path, Stream::binary | Stream::in);
+        if (!s.is_open()) {
+            const auto msg = "could not open file '" + path + "'";
+            throw std::invalid_argument(msg);
+        }
+
+        /*
+         * End-of-file is reported through gcount(), and seek errors are
+         * checked explicitly, so only exceptions on hard errors are useful
+         */
+        s.exceptions(std::ios::badbit);
+    }
+};
+
+/*
+ * A stream backend over a caller-owned, contiguous buffer, e.g. a file that
+ * is already in memory. The buffer is not copied, and must outlive the
+ * reader.
+ *
+ * Example
+ * -------
+ *  stream_reader< buffer_stream > fs(data, size);
+ */
+class buffer_stream {
+public:
+    void open(const void* data, std::size_t size) noexcept (true) {
+        this->begin = static_cast< const char* >(data);
+        this->size = size;
+        this->pos = 0;
+    }
+
+    std::size_t read(char* dst, std::size_t n) noexcept (true) {
+        n = std::min(n, this->size - this->pos);
+        /* begin is null for empty buffers, which memcpy does not allow */
+        if (n == 0) return 0;
+        std::memcpy(dst, this->begin + this->pos, n);
+        this->pos += n;
+        return n;
+    }
+
+    /* Move n bytes forward, and return false if that is past the end */
+    bool skip(std::uint64_t n) noexcept (true) {
+        const auto fits = n <= this->size - this->pos;
+        this->seek(fits ? this->pos + n : this->size);
+        return fits;
+    }
+
+    void seek(std::uint64_t offset) noexcept (true) {
+        this->pos = std::size_t(std::min< std::uint64_t >(offset, this->size));
+    }
+
+    std::uint64_t tell() const noexcept (true) {
+        return this->pos;
+    }
+
+private:
+    const char* begin = nullptr;
+    std::size_t size = 0;
+    std::size_t pos = 0;
+};
+
+template <>
+struct stream_traits< buffer_stream > {
+    static void open(buffer_stream& s, const void* data, std::size_t size) {
+        if (not data and size > 0)
+            throw std::invalid_argument("buffer is null, but size is not 0");
+        s.open(data, size);
+    }
+
+    static std::size_t read(buffer_stream& s, char* dst, std::size_t n) {
+        return s.read(dst, n);
+    }
+
+    static bool seekable(buffer_stream&) noexcept (true) {
+        return true;
+    }
+
+    static void skip(buffer_stream& s, std::uint64_t n) {
+        if (not s.skip(n))
+            throw std::runtime_error("unexpected end-of-file while skipping");
+    }
+
+    static std::uint64_t tell(buffer_stream& s) noexcept (true) {
+        return s.tell();
+    }
+
+    static void seek(buffer_stream& s, std::uint64_t offset) noexcept (true) {
+        s.seek(offset);
+    }
+};
+
+/*
+ * A stream backend over an already-open std::istream, e.g. std::cin or a
+ * std::istringstream. The stream is not owned, and must outlive the reader.
+ * Reading starts at the stream's current position.
+ *
+ * The reader relies on short reads to detect end-of-file, so the stream's
+ * exception mask is set to badbit while the reader is alive. When the reader
+ * is destroyed, the stream's state is cleared and the mask restored.
+ *
+ * Example
+ * -------
+ *  stream_reader< istream_ref > fs(std::cin);
+ */
+class istream_ref {
+public:
+    istream_ref() = default;
+    ~istream_ref() {
+        if (not this->is) return;
+        /* restoring the mask with eofbit set would throw */
+        this->is->clear();
+        this->is->exceptions(this->mask);
+    }
+
+    istream_ref(const istream_ref&) = delete;
+    istream_ref& operator=(const istream_ref&) = delete;
+
+    void open(std::istream& s) {
+        this->is = &s;
+        this->mask = s.exceptions();
+        s.exceptions(std::ios::badbit);
+    }
+
+    std::istream& get() noexcept (true) { return *this->is; }
+
+private:
+    std::istream* is = nullptr;
+    std::ios::iostate mask = std::ios::goodbit;
+};
+
+template <>
+struct stream_traits< istream_ref > {
+    using base = istream_traits< std::istream >;
+
+    static void open(istream_ref& s, std::istream& is) {
+        s.open(is);
+    }
+
+    static std::size_t read(istream_ref& s, char* dst, std::size_t n) {
+        return base::read(s.get(), dst, n);
+    }
+
+    static bool seekable(istream_ref& s) {
+        return base::seekable(s.get());
+    }
+
+    static void skip(istream_ref& s, std::uint64_t n) {
+        base::skip(s.get(), n);
+    }
+
+    static std::uint64_t tell(istream_ref& s) {
+        return base::tell(s.get());
+    }
+
+    static void seek(istream_ref& s, std::uint64_t offset) {
+        base::seek(s.get(), offset);
+    }
+};
+
 /*
  * A wrapper-type for iostream like interfaces to stream arrays. Manages
  * buffers internally, and should be treated like a black-box readline() until
@@ -47,8 +412,10 @@ struct raw_array {
  * for developing applications and function that loops through all arrays in a
  * file once.
  *
- * The Stream has to be API compatible, including some typedefs and enums, with
- * the C++ iostreams.
+ * The Stream is accessed through stream_traits< Stream >, which by default
+ * works with the C++ iostreams, i.e. Stream has to be API compatible with
+ * std::ifstream, including some typedefs and enums. Other backends, like
+ * fd_stream, specialise stream_traits.
  *
  * Reading from an array when empty is true is undefined.
  *
@@ -63,60 +430,267 @@ struct raw_array {
 template < typename Stream >
 class stream_reader : Stream {
 public:
-    explicit stream_reader(const std::string& path);
+    /*
+     * Open the stream. The arguments are forwarded to
+     * stream_traits< Stream >::open, and are backend-specific - for files
+     * it's the path, optionally followed by tuning parameters.
+     */
+    template < typename Source, typename... Args >
+    explicit stream_reader(Source&& source, Args&&... args);
 
     /*
-     * Read the next array. This function updates the the array in-place, and
-     * invalidates all pointers and references to previously-read arrays.
+     * Read the next array.
+     *
+     * Arrays are kept in a small ring of buffers, to support peek() and
+     * unget(), and the buffers are reused. A returned reference is valid
+     * until the array is pushed out of the ring, which can happen on any
+     * call to next() or peek(), so copy what should outlive the next read.
+     *
+     * At end-of-file, an empty array is returned.
      */
     const raw_array& next();
+
+    /*
+     * Read the next array, but hand its body to f in chunks as it is read
+     * and decoded, rather than collecting it in the array. f is called as
+     *
+     *  f(x, data, first, n)
+     *
+     * where x is the array header, and data holds elements [first, first + n)
+     * of the body, decoded just like next() would. data is only valid during
+     * the call. Only a chunk of the body is in memory at any time, so this
+     * works for arrays larger than memory, and computation can run while the
+     * rest of the body is still being read.
+     *
+     * The chunk size is in elements, and is rounded up to whole Fortran
+     * blocks, so that blocks are never split. The default of 0 is one block
+     * per call. The header is returned like from next_header(), i.e. with an
+     * empty body, and filters apply like for next(), and like for
+     * next_header() it can not be unget'd. Arrays already read by peek() are
+     * handed out from memory, and can be unget'd as usual.
+     *
+     * If f throws, the stream is left inside the body, and the reader must
+     * seek() to a known array to be used again.
+     *
+     * Example
+     * -------
+     *  double sum = 0;
+     *  fs.next_chunked([&](const raw_array&,
+     *                      const unsigned char* data,
+     *                      std::int64_t,
+     *                      std::int64_t n) {
+     *      const auto* xs = reinterpret_cast< const float* >(data);
+     *      sum += std::accumulate(xs, xs + n, 0.0);
+     *  }, 1000000);
+     */
+    using body_handler = std::function< void (const raw_array&,
+                                              const unsigned char*,
+                                              std::int64_t,
+                                              std::int64_t) >;
+    const raw_array& next_chunked(const body_handler& f,
+                                  std::int64_t chunk = 0);
+
+    /*
+     * Look at the array n positions ahead, without consuming it, i.e. peek(0)
+     * is the array the next call to next() returns. Peeked arrays are read
+     * and decoded once, and handed out by next() without reading them again.
+     *
+     * This is useful since the only way to determine if a report step is over
+     * is checking if the next array is a SEQHDR or end-of-file.
+     *
+     * If there are fewer than n + 1 arrays left, an empty array is returned.
+     */
+    const raw_array& peek(std::size_t n = 0);
+
+    /*
+     * Unget the previously-read array, so that the next call to next()
+     * returns it again. unget() can be called repeatedly to step further
+     * back, as long as the arrays are still in the ring. The array returned
+     * by the latest next() can always be unget'd, unless a peek() far ahead
+     * has pushed it out since. Returns false, and does nothing, if there is
+     * nothing to unget.
+     *
+     * Arrays without a body, i.e. headers returned by next_header(), and
+     * arrays whose body was streamed by next_chunked(), can not be unget'd,
+     * as next() would hand them out incomplete. They act as a
+     * barrier, and unget() returns false right after one.
+     */
+    bool unget() noexcept (true);
+
+    /*
+     * Read the header of the next array, and skip past its body without
+     * reading it. The body size is computed from the count and type, so
+     * skipping is a single seek. The returned array has an empty body, and
+     * can not be unget'd. Arrays already read by peek() are handed out from
+     * memory, body included, and can be unget'd as usual.
+     *
+     * This requires a seekable stream, and is the building block for
+     * indexing files, see toc.hpp.
+     */
+    const raw_array& next_header();
+
+    /*
+     * The current position in the stream, i.e. the offset of the next array's
+     * header. Only defined between arrays, and not after unget() or peek().
+     */
+    std::uint64_t tell();
+
+    /*
+     * Move to offset, which must be the start of an array header, e.g. an
+     * offset obtained from tell(). The next call to next() reads the array at
+     * offset. Any unget'd or peeked-at arrays are discarded.
+     */
+    void seek(std::uint64_t offset);
+
+    /*
+     * Only read arrays for which the predicate returns true. The predicate is
+     * called with the header of every array, i.e. the keyword, type and count
+     * is set, but the body is not. Bodies of the other arrays are skipped
+     * without being decoded or copied into the array - on seekable streams
+     * with a single seek, and on pipes by draining them through a small fixed
+     * buffer.
+     *
+     * next_header() is not filtered, so that indexing still sees all arrays.
+     * Arrays that are already peeked at are not filtered again. An empty
+     * predicate disables filtering.
+     */
+    using predicate = std::function< bool (const raw_array&) >;
+    void filter(predicate p);
+
+    /*
+     * Only read arrays with keywords in the allow-list. Keywords shorter than
+     * 8 characters are padded with spaces, like in the file. This is
+     * shorthand for filter() with a predicate that compares keyword tokens.
+     */
+    void select(const std::vector< std::string >& keywords);
+
     /*
-     * Unget the previously-read record. When this is called, the file will
-     * pretend to rewind as if the last array was not read, and return it next
-     * time. Only one array can be unget'd.
+     * Keep array bodies in their on-disk representation, i.e. do not convert
+     * to native types when reading. This is useful when the body is going to
+     * be converted with ecl3_get_native_as anyway, to not decode it twice.
+     * The block markers are always removed.
+     */
+    void raw_bodies(bool enable) noexcept (true);
+
+    /*
+     * Decode the bodies of large arrays, at least min_count elements, on a
+     * pool of threads. The blocking of a body is fixed by its count and
+     * type, so once the body is read the blocks are independent, and the
+     * record markers are checked, and the blocks byte-swapped and copied, in
+     * parallel. Smaller arrays are decoded on the calling thread, as the
+     * hand-off costs more than it saves.
      *
-     * Using unget() can be used to emulate peek(), by calling next() and then
-     * unget(). This is useful since the only way to determine if a report step
-     * is over is checking if the next array is a SEQHDR or the next character
-     * is end-of-file.
+     * The pool is owned by the reader and is started here. A threads of 0 or
+     * 1 turns parallel decoding off, which is the default.
+     *
+     * Example
+     * -------
+     *  stream_reader< std::ifstream > fs("CASE.UNRST");
+     *  fs.parallel_decode(std::thread::hardware_concurrency());
+     */
+    void parallel_decode(unsigned threads,
+                         std::int64_t min_count = 1000000);
+
+    /*
+     * The byte order of the file, as one of enum ecl3_byteorders. The byte
+     * order is detected from the first array header, and is 0 before the
+     * first call to next().
      *
-     * If unget() is called before next(), behaviour is undefined.
+     * With raw_bodies enabled, the bodies are in this byte order.
+     */
+    int byteorder() const noexcept (true);
+
+    /*
+     * The size, in bytes, of the file's record markers, either 4 or 8. Like
+     * the byte order, this is detected from the first array header, and is 0
+     * before the first call to next().
      */
-    void unget() noexcept (true);
+    int record_marker_size() const noexcept (true);
 
 private:
-    raw_array last;
+    using traits = stream_traits< Stream >;
 
-    void read_head();
-    void read_body();
+    /*
+     * Read arrays are kept in a ring, to support peek() and unget(). The
+     * counters are running array numbers, and array i is stored in
+     * ring[i % ring.size()]. Arrays [first, cursor) have been returned by
+     * next() and can be unget'd, and [cursor, last) have been read, but not
+     * yet returned.
+     */
+    std::vector< raw_array > ring;
+    std::uint64_t first = 0;
+    std::uint64_t cursor = 0;
+    std::uint64_t last = 0;
+    bool at_eof = false;
+    raw_array eof;
 
-    bool ungetted = false;
+    predicate keep;
+    /* grow-only buffer for the on-disk body, record markers included */
+    uninitialized_vector< char > scratch;
+    /* grow-only buffer for the decoded chunks of next_chunked() */
+    uninitialized_vector< unsigned char > chunkbuf;
+
+    raw_array& make_room();
+    bool fetch(bool body);
+    void read_head(raw_array& x);
+    void read_body(raw_array& x);
+    void stream_body(const raw_array& x,
+                     const body_handler& f,
+                     std::int64_t chunk);
+    void decode_blocks(const char* src,
+                       unsigned char* dst,
+                       int type,
+                       int size,
+                       int blocksize,
+                       std::int64_t remaining,
+                       std::int64_t blocks) const;
+    void skip_body(raw_array& x);
+    void drain(std::uint64_t size);
+    void read_exactly(char* dst, std::size_t n, const char* what);
+    Stream& stream() noexcept (true) { return *this; }
+
+    int seekable = -1;
+    bool decode = true;
+    int order = 0;
+    int marker = 0;
+
+    std::unique_ptr< thread_pool > pool;
+    std::int64_t parallel_min = 0;
 };
 
 template < typename Stream >
-stream_reader< Stream >::stream_reader(const std::string& path) :
-    Stream(path, Stream::binary | Stream::in)
-{
-    if (!this->is_open()) {
-        const auto msg = "could not open file '" + path + "'";
-        throw std::invalid_argument(msg);
-    }
-
-    auto errors = std::ios::failbit | std::ios::badbit | std::ios::eofbit;
-    this->exceptions(errors);
+template < typename Source, typename... Args >
+stream_reader< Stream >::stream_reader(Source&& source, Args&&... args) {
+    traits::open(this->stream(),
+                 std::forward< Source >(source),
+                 std::forward< Args >(args)...);
+    this->eof.count = -1;
 }
 
 namespace {
 
-void check_headtail(std::array< char, sizeof(std::int32_t) > head,
-                    std::array< char, sizeof(std::int32_t) > tail) {
-    if (head == tail)
+/*
+ * Read a record marker of size bytes. There is no 8-byte integer type in
+ * ecl3_typeids, but the byte swap of DOUB works just as well for int64.
+ */
+std::int64_t record_length(const char* marker, int size, int order) {
+    if (size == sizeof(std::int32_t)) {
+        std::int32_t len;
+        ecl3_get_native_from(&len, marker, ECL3_INTE, 1, order);
+        return len;
+    }
+
+    std::int64_t len;
+    ecl3_get_native_from(&len, marker, ECL3_DOUB, 1, order);
+    return len;
+}
+
+void check_headtail(const char* head, const char* tail, int size, int order) {
+    if (std::memcmp(head, tail, size) == 0)
         return;
 
-    std::int32_t h;
-    std::int32_t t;
-    ecl3_get_native(&h, head.data(), ECL3_INTE, 1);
-    ecl3_get_native(&t, tail.data(), ECL3_INTE, 1);
+    const auto h = record_length(head, size, order);
+    const auto t = record_length(tail, size, order);
 
     std::stringstream msg;
     msg << "head/tail mismatch: "
@@ -130,114 +704,497 @@ void check_headtail(std::array< char, sizeof(std::int32_t) > head,
 }
 
 template < typename Stream >
-void stream_reader< Stream >::read_head() {
-    std::array< char, sizeof(std::int32_t) > head;
-    std::array< char, 16 > header;
-    std::array< char, sizeof(std::int32_t) > tail;
+void stream_reader< Stream >::read_head(raw_array& x) {
+    /* head, header, and tail, laid out as on disk */
+    std::array< char, 8 + 16 + 8 > record;
 
     // TODO: -> unsigned char (with casts)
 
-    try {
-        this->read(head.data(), sizeof(head));
-    } catch (typename Stream::failure&) {
-        if (this->eof()) {
-            this->last.count = -1;
-            return;
+    /*
+     * The format is detected from the first 8 bytes of the file, so read
+     * them before the marker size is known. This is all a stream of 4-byte
+     * markers must have anyway, since it's followed by the keyword. Once the
+     * marker size is known, the whole record is read at once.
+     */
+    const auto first = this->marker == 0 ? 8 : 2 * this->marker + 16;
+    const auto got = traits::read(this->stream(), record.data(), first);
+    if (got == 0) {
+        x.count = -1;
+        return;
+    }
+
+    if (got != std::size_t(first))
+        throw header_error("unexpected end-of-file in header");
+
+    if (this->marker == 0) {
+        const auto err = ecl3_detect_record_marker(
+            record.data(),
+            &this->order,
+            &this->marker
+        );
+
+        if (err) {
+            throw header_error("unable to detect record marker from header");
         }
 
-        /* some error is set - propagate exception */
-        throw;
+        const auto rest = 2 * this->marker + 16 - first;
+        this->read_exactly(record.data() + first, rest, "header");
     }
 
-    this->read(header.data(), sizeof(header));
-    this->read(tail.data(), sizeof(tail));
-    check_headtail(head, tail);
-    const auto err = ecl3_array_header(
-        header.data(),
-        this->last.keyword.data(),
-        this->last.type.data(),
-        &this->last.count
+    const auto size = this->marker;
+    const auto* head   = record.data();
+    const auto* header = record.data() + size;
+    const auto* tail   = record.data() + size + 16;
+
+    check_headtail(head, tail, size, this->order);
+
+    int count;
+    const auto err = ecl3_array_header_from(
+        header,
+        x.keyword.data(),
+        x.type.data(),
+        &count,
+        this->order
     );
 
     if (err) {
         throw header_error("error parsing header");
     }
+
+    if (count < 0) {
+        std::stringstream ss;
+        ss << "negative array length (" << count << ")";
+        throw header_error(ss.str());
+    }
+    x.count = count;
+    x.token = keyword_token(x.keyword);
 }
 
-template < typename Stream >
-void stream_reader< Stream >::read_body() {
-    std::array< char, sizeof(std::int32_t) > head;
-    std::array< char, sizeof(std::int32_t) > tail;
+namespace {
 
+int array_typeid(const raw_array& x) {
     int type;
-    int size;
-    int blocksize;
-    auto err = ecl3_typeid(this->last.type.data(), &type);
+    const auto err = ecl3_typeid(x.type.data(), &type);
     if (err) {
         std::stringstream ss;
         ss << "unknown type"
            << "'"
-           << std::string(this->last.type.data(), this->last.type.size())
+           << std::string(x.type.data(), x.type.size())
            << "'"
         ;
         throw std::invalid_argument(ss.str());
     }
+    return type;
+}
+
+}
+
+/*
+ * The size, in bytes, of a blocked array body on disk, including all the
+ * record markers
+ */
+inline std::uint64_t body_size(int type, std::int64_t count, int marker) {
+    int size;
+    int blocksize;
+    const auto err = ecl3_type_size(type, &size)
+                  or ecl3_block_size(type, &blocksize)
+                  ;
+    if (err) {
+        std::stringstream ss;
+        ss << "unable to compute body size of type "
+           << "'" << ecl3_type_name(type) << "'"
+        ;
+        throw invalid_type(ss.str());
+    }
+
+    const auto elems = std::uint64_t(count);
+    const auto blocks = (elems + blocksize - 1) / blocksize;
+    return elems * size + blocks * 2 * marker;
+}
+
+template < typename Stream >
+void stream_reader< Stream >::skip_body(raw_array& x) {
+    const auto type = array_typeid(x);
+    const auto size = body_size(type, x.count, this->marker);
+    x.body.clear();
+
+    if (this->seekable == -1)
+        this->seekable = traits::seekable(this->stream());
+
+    if (this->seekable)
+        traits::skip(this->stream(), size);
+    else
+        this->drain(size);
+}
+
+template < typename Stream >
+void stream_reader< Stream >::drain(std::uint64_t size) {
+    std::array< char, 8192 > sink;
+    while (size > 0) {
+        const auto n = std::min(size, std::uint64_t(sink.size()));
+        this->read_exactly(sink.data(), std::size_t(n), "array body");
+        size -= n;
+    }
+}
+
+template < typename Stream >
+void stream_reader< Stream >::read_exactly(char* dst,
+                                           std::size_t n,
+                                           const char* what) {
+    if (traits::read(this->stream(), dst, n) == n)
+        return;
+
+    throw std::runtime_error(std::string("unexpected end-of-file in ") + what);
+}
+
+template < typename Stream >
+void stream_reader< Stream >::read_body(raw_array& x) {
+    const auto type = array_typeid(x);
+    int size;
+    int blocksize;
     ecl3_type_size(type, &size);
     ecl3_block_size(type, &blocksize);
 
-    auto buffer = std::vector< char >();
-    int remaining = this->last.count;
-    this->last.body.clear();
-    while (remaining > 0) {
-        this->read(head.data(), sizeof(head));
-        std::int32_t elems;
-        ecl3_get_native(&elems, head.data(), ECL3_INTE, 1);
-
-        buffer.resize(elems);
-        auto prev_size = this->last.body.size();
-        this->read(buffer.data(), elems);
-
-        this->read(tail.data(), sizeof(tail));
-        check_headtail(head, tail);
-
-        int count;
-        this->last.body.resize(prev_size + elems);
-        err = ecl3_array_body(
-            this->last.body.data() + prev_size,
-            buffer.data(),
-            type,
-            remaining,
-            blocksize,
-            &count
-        );
+    /*
+     * The blocking is fixed by the type, so the on-disk size of the body,
+     * markers included, is known up front. Read it all at once, and then
+     * check and decode the blocks from memory.
+     */
+    const auto marker = this->marker;
+    const auto total = body_size(type, x.count, marker);
+    this->scratch.resize(std::size_t(total));
+    this->read_exactly(this->scratch.data(), std::size_t(total), "array body");
 
-        if (err) {
-            throw std::runtime_error("error parsing array body");
+    x.body.resize(std::size_t(x.count * size));
+    const auto blocks = (x.count + blocksize - 1) / blocksize;
+
+    const auto* src = this->scratch.data();
+    auto* dst = x.body.data();
+    if (not this->pool or x.count < this->parallel_min) {
+        this->decode_blocks(src, dst, type, size, blocksize, x.count, blocks);
+        return;
+    }
+
+    /*
+     * A few chunks per thread evens out the load when some threads get less
+     * time, without making chunks so small the hand-off dominates
+     */
+    const auto threads = std::int64_t(this->pool->size());
+    const auto chunks = std::min(blocks, threads * 4);
+    const auto elems  = std::int64_t(blocksize);
+    const auto stride = elems * size + 2 * marker;
+    this->pool->parallel_for(std::size_t(chunks), [&](std::size_t i) {
+        const auto c = std::int64_t(i);
+        const auto begin = blocks * c / chunks;
+        const auto end   = blocks * (c + 1) / chunks;
+        this->decode_blocks(src + begin * stride,
+                            dst + begin * elems * size,
+                            type,
+                            size,
+                            blocksize,
+                            x.count - begin * elems,
+                            end - begin);
+    });
+}
+
+/*
+ * Check and decode a run of consecutive on-disk blocks at src, record
+ * markers included, into dst. remaining is the number of elements left in
+ * the array from src on, so that the last block can be short. Only src and
+ * dst are touched, so disjoint block ranges can be decoded concurrently.
+ */
+template < typename Stream >
+void stream_reader< Stream >::decode_blocks(const char* src,
+                                           unsigned char* dst,
+                                           int type,
+                                           int size,
+                                           int blocksize,
+                                           std::int64_t remaining,
+                                           std::int64_t blocks) const {
+    const auto marker = this->marker;
+    for (std::int64_t b = 0; b < blocks; ++b) {
+        const auto elems = std::min(remaining, std::int64_t(blocksize));
+        const auto expected = elems * size;
+        const auto len = record_length(src, marker, this->order);
+        if (len != expected) {
+            std::stringstream ss;
+            ss << "unexpected record length (" << len << ")"
+               << ", expected " << expected
+            ;
+            throw std::runtime_error(ss.str());
         }
 
-        remaining -= count;
+        const auto* block = src + marker;
+        check_headtail(src, block + len, marker, this->order);
+
+        if (this->decode) {
+            int count;
+            const auto err = ecl3_array_body_from(
+                dst,
+                block,
+                type,
+                remaining,
+                blocksize,
+                &count,
+                this->order
+            );
+
+            if (err) {
+                throw std::runtime_error("error parsing array body");
+            }
+        } else {
+            std::memcpy(dst, block, std::size_t(len));
+        }
+
+        src += len + 2 * marker;
+        dst += len;
+        remaining -= elems;
+    }
+}
+
+/*
+ * Get the buffer for the next array to be read, making room in the ring if
+ * necessary. unget'able arrays are evicted first, and the ring only grows
+ * when all of it is peeked-at arrays.
+ */
+template < typename Stream >
+raw_array& stream_reader< Stream >::make_room() {
+    if (this->ring.empty())
+        this->ring.resize(4);
+
+    const auto size = this->ring.size();
+    if (this->last - this->first < size)
+        return this->ring[this->last % size];
+
+    if (this->first < this->cursor) {
+        ++this->first;
+        return this->ring[this->last % size];
     }
 
-    if (remaining != 0)
-        throw std::runtime_error("array not terminated correctly");
+    std::vector< raw_array > larger(2 * size);
+    for (auto i = this->first; i < this->last; ++i)
+        larger[i % larger.size()] = std::move(this->ring[i % size]);
+    this->ring.swap(larger);
+    return this->ring[this->last % this->ring.size()];
+}
+
+/*
+ * Read the next array into the ring, and return false on end-of-file. With
+ * body = false, only the header is read.
+ */
+template < typename Stream >
+bool stream_reader< Stream >::fetch(bool body) {
+    if (this->at_eof) return false;
+
+    auto& x = this->make_room();
+    while (true) {
+        this->read_head(x);
+        if (x.empty()) {
+            this->at_eof = true;
+            return false;
+        }
+
+        if (body and (not this->keep or this->keep(x)))
+            break;
+
+        this->skip_body(x);
+        if (not body) {
+            ++this->last;
+            return true;
+        }
+    }
+
+    this->read_body(x);
+    ++this->last;
+    return true;
 }
 
 template < typename Stream >
 const raw_array& stream_reader< Stream >::next() {
-    if (this->ungetted) {
-        this->ungetted = false;
-        return this->last;
+    if (this->cursor == this->last and not this->fetch(true))
+        return this->eof;
+
+    return this->ring[this->cursor++ % this->ring.size()];
+}
+
+template < typename Stream >
+const raw_array& stream_reader< Stream >::next_chunked(const body_handler& f,
+                                                       std::int64_t chunk) {
+    if (this->cursor < this->last) {
+        const auto& x = this->ring[this->cursor++ % this->ring.size()];
+        const auto type = array_typeid(x);
+        int size;
+        int blocksize;
+        ecl3_type_size(type, &size);
+        ecl3_block_size(type, &blocksize);
+
+        const auto blocks = std::max< std::int64_t >(1,
+            (chunk + blocksize - 1) / blocksize
+        );
+        const auto step = blocks * blocksize;
+        for (std::int64_t first = 0; first < x.count; first += step) {
+            const auto n = std::min(step, x.count - first);
+            f(x, x.body.data() + first * size, first, n);
+        }
+        return x;
+    }
+
+    if (this->at_eof)
+        return this->eof;
+
+    auto& x = this->make_room();
+    while (true) {
+        this->read_head(x);
+        if (x.empty()) {
+            this->at_eof = true;
+            return this->eof;
+        }
+
+        if (not this->keep or this->keep(x))
+            break;
+
+        this->skip_body(x);
+    }
+
+    /*
+     * The header goes in the ring before the body is streamed, so that it is
+     * consistent even if f throws. It has no body, so like for next_header(),
+     * it is moved out of reach of unget()
+     */
+    x.body.clear();
+    ++this->last;
+    this->first = ++this->cursor;
+    this->stream_body(x, f, chunk);
+    return x;
+}
+
+/*
+ * Read, check and decode the body of x a group of blocks at a time, and pass
+ * each group to f. Memory use is bounded by the chunk size.
+ */
+template < typename Stream >
+void stream_reader< Stream >::stream_body(const raw_array& x,
+                                          const body_handler& f,
+                                          std::int64_t chunk) {
+    const auto type = array_typeid(x);
+    int size;
+    int blocksize;
+    ecl3_type_size(type, &size);
+    ecl3_block_size(type, &blocksize);
+
+    const auto blocks = std::max< std::int64_t >(1,
+        (chunk + blocksize - 1) / blocksize
+    );
+    const auto step = std::min(blocks * blocksize, x.count);
+    this->chunkbuf.resize(std::size_t(step * size));
+
+    for (std::int64_t first = 0; first < x.count; first += step) {
+        const auto n = std::min(step, x.count - first);
+        const auto len = body_size(type, n, this->marker);
+        this->scratch.resize(std::size_t(len));
+        this->read_exactly(this->scratch.data(),
+                           std::size_t(len),
+                           "array body");
+
+        this->decode_blocks(this->scratch.data(),
+                            this->chunkbuf.data(),
+                            type,
+                            size,
+                            blocksize,
+                            n,
+                            (n + blocksize - 1) / blocksize);
+        f(x, this->chunkbuf.data(), first, n);
+    }
+}
+
+template < typename Stream >
+const raw_array& stream_reader< Stream >::peek(std::size_t n) {
+    while (this->last - this->cursor <= n) {
+        if (not this->fetch(true))
+            return this->eof;
     }
 
-    this->read_head();
-    if (!this->last.empty())
-        this->read_body();
-    return this->last;
+    return this->ring[(this->cursor + n) % this->ring.size()];
+}
+
+template < typename Stream >
+bool stream_reader< Stream >::unget() noexcept (true) {
+    if (this->cursor == this->first)
+        return false;
+
+    --this->cursor;
+    return true;
+}
+
+template < typename Stream >
+const raw_array& stream_reader< Stream >::next_header() {
+    if (this->cursor < this->last)
+        return this->ring[this->cursor++ % this->ring.size()];
+
+    if (not this->fetch(false))
+        return this->eof;
+
+    /*
+     * The body is skipped, so next() can't hand this array out again. Move
+     * first past it, so that it, and the arrays before it, can't be unget'd
+     */
+    this->first = ++this->cursor;
+    return this->ring[(this->cursor - 1) % this->ring.size()];
+}
+
+template < typename Stream >
+std::uint64_t stream_reader< Stream >::tell() {
+    return traits::tell(this->stream());
+}
+
+template < typename Stream >
+void stream_reader< Stream >::seek(std::uint64_t offset) {
+    traits::seek(this->stream(), offset);
+    this->first = this->cursor = this->last = 0;
+    this->at_eof = false;
+}
+
+template < typename Stream >
+void stream_reader< Stream >::filter(predicate p) {
+    this->keep = std::move(p);
+}
+
+template < typename Stream >
+void stream_reader< Stream >::select(const std::vector< std::string >& kws) {
+    std::vector< keyword_token > allowed;
+    for (const auto& kw : kws)
+        allowed.push_back(keyword_token::from_string(kw));
+
+    this->keep = [allowed](const raw_array& x) {
+        const auto end = allowed.end();
+        return std::find(allowed.begin(), end, x.token) != end;
+    };
+}
+
+template < typename Stream >
+void stream_reader< Stream >::raw_bodies(bool enable) noexcept (true) {
+    this->decode = not enable;
+}
+
+template < typename Stream >
+void stream_reader< Stream >::parallel_decode(unsigned threads,
+                                             std::int64_t min_count) {
+    if (threads <= 1)
+        this->pool.reset();
+    else if (not this->pool or this->pool->size() != threads)
+        this->pool.reset(new thread_pool(threads));
+
+    this->parallel_min = min_count;
+}
+
+template < typename Stream >
+int stream_reader< Stream >::byteorder() const noexcept (true) {
+    return this->order;
 }
 
 template < typename Stream >
-void stream_reader< Stream >::unget() noexcept (true) {
-    this->ungetted = true;
+int stream_reader< Stream >::record_marker_size() const noexcept (true) {
+    return this->marker;
 }
 
 }
@@ -1,6 +1,9 @@
 #ifndef ECL3_KEYWORD_H
 #define ECL3_KEYWORD_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <ecl3/common.h>
 
 #ifdef __cplusplus
@@ -31,9 +34,17 @@ extern "C" {
  *
  *     | 400 | data ...... | 400 |
  *
- * As per the gnu fortran manual [1], the record byte marker is int32. We could
- * support 8-byte markers with either compile-time configuration or a run-time
- * switch, but as of now this is not implemented.
+ * As per the gnu fortran manual [1], the record byte marker is int32. Some
+ * compilers and vendor tools write 8-byte markers instead. The functions in
+ * this module are unaware of the record markers, with the exception of
+ * ecl3_detect_record_marker, which can figure out the marker size (and byte
+ * order) of a file, and ecl3_scan_arrays, which walks whole records.
+ *
+ * Files written by the simulators are big-endian, and this is what the
+ * functions in this module assume unless otherwise noted. Some tools write
+ * files in little-endian instead, which can be read with the *_from variants
+ * of the functions, which take an explicit byte order. The byte order of a
+ * file can be determined with ecl3_detect_byteorder.
  *
  * [1] http://gcc.gnu.org/onlinedocs/gfortran/File-format-of-unformatted-sequential-files.html
  *
@@ -115,6 +126,206 @@ int ecl3_get_native(void* dst, const void* src, int fmt, size_t elems);
 ECL3_API
 int ecl3_put_native(void* dst, const void* src, int fmt, size_t elems);
 
+/**
+ * Copy elements of type fmt in byte order order from src to dst
+ *
+ * Like ecl3_get_native, but for src in any byte order, given as one of enum
+ * ecl3_byteorders. When order is the same as the host's byte order, this is a
+ * plain copy, and a no-op when dst == src.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * ECL3_INVALID_ARGS
+ *    fmt or order is unknown
+ * ECL3_UNSUPPORTED
+ *    fmt is a known and valid value, but is not yet supported
+ * \endrst
+ *
+ * @see ecl3_get_native
+ * @see ecl3_detect_byteorder
+ */
+ECL3_API
+int ecl3_get_native_from(void* dst,
+                         const void* src,
+                         int fmt,
+                         size_t elems,
+                         int order);
+
+/**
+ * Copy elements of type fmt from src to dst, converting to native type
+ *
+ * Like ecl3_get_native, but dst holds values of a native type that is not
+ * necessarily the type on disk, given as one of enum ecl3_native_types. The
+ * byte swap and widening (or narrowing) is done in a single pass, so there is
+ * no need for an intermediate buffer of the on-disk type.
+ *
+ * Supported conversions:
+ *
+ * \rst
+ * ========= ==========================================
+ * fmt       native
+ * --------- ------------------------------------------
+ * ECL3_INTE int32, int64, float, double
+ * ECL3_REAL float, double
+ * ECL3_DOUB float, double
+ * ========= ==========================================
+ * \endrst
+ *
+ * The float/double conversions follow the C rules, i.e. narrowing rounds to
+ * the nearest representable value. src and dst must not overlap, unless fmt
+ * and native are the same type.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * ECL3_INVALID_ARGS
+ *    fmt or native is unknown
+ * ECL3_UNSUPPORTED
+ *    fmt is a known and valid value, but cannot be converted to native
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Read a block of REAL straight into doubles:
+ *
+ *     double data[1000];
+ *     fread(buffer, sizeof(float), elems, fp);
+ *     ecl3_get_native_as(data, buffer, ECL3_REAL, ECL3_NATIVE_DOUBLE, elems);
+ */
+ECL3_API
+int ecl3_get_native_as(void* dst,
+                       const void* src,
+                       int fmt,
+                       int native,
+                       size_t elems);
+
+/**
+ * Copy elements of type fmt in byte order order from src to dst, converting
+ * to native type
+ *
+ * @see ecl3_get_native_as
+ * @see ecl3_get_native_from
+ */
+ECL3_API
+int ecl3_get_native_as_from(void* dst,
+                            const void* src,
+                            int fmt,
+                            int native,
+                            size_t elems,
+                            int order);
+
+/**
+ * Pack LOGI elements from src into a bitset in dst
+ *
+ * Logicals are stored as 4-byte integers, but only carry a single bit. This
+ * function packs elems of them into 64-bit words, so a decoded LOGI array
+ * takes 32 times less memory. Element i is bit (i % 64) of dst[i / 64], and
+ * the unused high bits of the last word are zero, so dst must have room for
+ * (elems + 63) / 64 words.
+ *
+ * An element is true if it is non-zero. This is independent of byte order,
+ * so src can be the on-disk data in either byte order, or already decoded.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Pack a block of ACTNUM-style flags:
+ *
+ *     uint64_t bits[(1000 + 63) / 64];
+ *     fread(buffer, sizeof(int32_t), 1000, fp);
+ *     ecl3_pack_logi(bits, buffer, 1000);
+ *     uint64_t active = ecl3_popcount(bits, 1000);
+ */
+ECL3_API
+int ecl3_pack_logi(uint64_t* dst, const void* src, size_t elems);
+
+/**
+ * Count the set bits among the first nbits bits of a packed bitset
+ *
+ * The bitset layout is that of ecl3_pack_logi.
+ */
+ECL3_API
+uint64_t ecl3_popcount(const uint64_t* bits, size_t nbits);
+
+/**
+ * Rank of position pos in a packed bitset
+ *
+ * The number of set bits in [0, pos), i.e. for an array of active-cell flags,
+ * the index of cell pos among the active cells. This is a popcount of the
+ * preceding words, so for many lookups in a large bitset, build a table of
+ * ranks at regular intervals, see ecl3::logi_bitset in typed.hpp.
+ */
+ECL3_API
+uint64_t ecl3_rank(const uint64_t* bits, size_t pos);
+
+/**
+ * The host's byte order
+ *
+ * Get the byte order of this machine, as one of enum ecl3_byteorders.
+ */
+ECL3_API
+int ecl3_native_byteorder(void);
+
+/**
+ * Detect the byte order of a file
+ *
+ * Determine the byte order of a file from its first record, which is always
+ * an array header. src should point to the start of the file, and must be at
+ * least 24 bytes, i.e. the header with its head and tail. This function
+ * checks that the head and tail matches, that the type is valid, and that the
+ * record length is 16, which can only be read as such in one byte order.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success, and order is set
+ * ECL3_INVALID_ARGS
+ *    src is not an array header in either byte order
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Read the first header of a file in any byte order:
+ *
+ *     char buffer[24];
+ *     int order;
+ *     fread(buffer, sizeof(buffer), 1, fp);
+ *     ecl3_detect_byteorder(buffer, &order);
+ *     ecl3_array_header_from(buffer + 4, kw, type, &count, order);
+ */
+ECL3_API
+int ecl3_detect_byteorder(const void* src, int* order);
+
+/**
+ * Detect the record marker size and byte order of a file
+ *
+ * Like ecl3_detect_byteorder, but also determine if the file uses 4- or
+ * 8-byte record markers. src should point to the start of the file, and must
+ * be at least 8 bytes. The first record is always the 16 byte array header,
+ * and since no keyword starts with four zero bytes, the first 8 bytes are
+ * enough to tell the formats apart.
+ *
+ * The output size is in bytes, i.e. 4 or 8.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success, and order and size are set
+ * ECL3_INVALID_ARGS
+ *    src does not start with an array header record marker
+ * \endrst
+ */
+ECL3_API
+int ecl3_detect_record_marker(const void* src, int* order, int* size);
+
 
 /**
  * Convert from in-file string representation to ecl3_typeids value
@@ -233,6 +444,42 @@ int ecl3_array_header_size();
 ECL3_API
 int ecl3_array_header(const void* src, char* keyword, char* type, int* count);
 
+/**
+ * Parse keyword header in byte order order
+ *
+ * @see ecl3_array_header
+ * @see ecl3_detect_byteorder
+ */
+ECL3_API
+int ecl3_array_header_from(const void* src,
+                           char* keyword,
+                           char* type,
+                           int* count,
+                           int order);
+
+/**
+ * Pack a keyword into a 64-bit token
+ *
+ * Keywords are 8 characters, and fit in a single integer, which makes
+ * comparing keywords a single integer compare, e.g. when looking for a
+ * particular keyword among many headers. Byte i of the keyword is bits
+ * [8i, 8i + 8) of the token, so tokens are the same on all hosts.
+ *
+ * keyword is read up to its first null, or 8 characters, whichever comes
+ * first, and padded with spaces, so the keywords from ecl3_array_header
+ * and null-terminated literals like "SEQHDR" give the same tokens as the
+ * keywords in the file.
+ *
+ * **Examples**
+ *
+ * Check if a header is a SEQHDR:
+ *
+ *     ecl3_array_header(src, kw, type, &count);
+ *     if (ecl3_keyword_token(kw) == ecl3_keyword_token("SEQHDR")) ...
+ */
+ECL3_API
+uint64_t ecl3_keyword_token(const char* keyword);
+
 #define ECL3_BLOCK_SIZE_NUMERIC 1000
 #define ECL3_BLOCK_SIZE_STRING  105
 
@@ -267,7 +514,9 @@ int ecl3_block_size(int type, int* size);
  * @param dst output buffer
  * @param src input buffer, as read from disk
  * @param type from the keyword header, should one of enum ecl3_typeids
- * @param elems remaining elements in the array
+ * @param elems remaining elements in the array. This is 64-bit, so that
+ *              callers can count down the remaining elements of arbitrarily
+ *              large arrays without truncating
  * @param chunk_size number of elements before the function pauses
  * @param count number of elements read
  *
@@ -307,10 +556,88 @@ ECL3_API
 int ecl3_array_body(void* dst,
                     const void* src,
                     int type,
-                    int elems,
+                    int64_t elems,
                     int chunk_size,
                     int* count);
 
+/**
+ * Read chunks of array body items of type in byte order order
+ *
+ * @see ecl3_array_body
+ * @see ecl3_detect_byteorder
+ */
+ECL3_API
+int ecl3_array_body_from(void* dst,
+                         const void* src,
+                         int type,
+                         int64_t elems,
+                         int chunk_size,
+                         int* count,
+                         int order);
+
+/*
+ * A contiguous range of on-disk body blocks for ecl3_array_body_ranges, like
+ * struct iovec. data points to the head record marker of the first block in
+ * the range, and size is the length of the range in bytes, markers included.
+ */
+struct ecl3_body_range {
+    const void* data;
+    size_t      size;
+};
+
+/**
+ * Check and decode a whole blocked array body in one call
+ *
+ * Where ecl3_array_body decodes a single block, and the caller must step over
+ * the record markers, this function takes the whole body, as a list of
+ * ranges of complete records, and decodes it into dst. The body can be in a
+ * single range, e.g. from a memory mapped file, or scattered over several,
+ * e.g. the buffers it was read into, as long as no record is split between
+ * ranges.
+ *
+ * All record markers are checked before anything is decoded: every block
+ * must have matching head and tail, and the length the blocking of elems
+ * elements of type gives. On error, dst is left untouched. Then the blocks
+ * are decoded in one pass.
+ *
+ * marker is the record marker size, 4 or 8, and order the byte order of the
+ * file, as output by ecl3_detect_record_marker. count is the number of
+ * elements decoded, which is elems on success. The ranges must hold exactly
+ * the body of elems elements, no more.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * ECL3_INVALID_ARGS
+ *    type, marker or order is unknown, a record is broken or split between
+ *    ranges, or the ranges do not hold exactly elems elements
+ * ECL3_UNSUPPORTED
+ *    type is a known and valid value, but is not yet supported
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Decode an array body from a memory mapped file, indexed with
+ * ecl3_scan_arrays:
+ *
+ *     struct ecl3_body_range body;
+ *     body.data = data + entry.body_offset;
+ *     body.size = entry.body_size;
+ *     ecl3_typeid(entry.type, &type);
+ *     err = ecl3_array_body_ranges(dst, &body, 1, type, entry.count,
+ *                                  marker, order, &count);
+ */
+ECL3_API
+int ecl3_array_body_ranges(void* dst,
+                           const struct ecl3_body_range* ranges,
+                           size_t nranges,
+                           int type,
+                           int64_t elems,
+                           int marker,
+                           int order,
+                           int64_t* count);
+
 /*
  * The array data types in the manual. In the file format, these are specified
  * as 4-character strings, but it's useful to have a numerical representation
@@ -439,6 +766,101 @@ enum ecl3_typeids {
     ECL3_C099 = ECL3_MAKE_KWENUM("C099"),
 };
 
+/*
+ * The byte orders of files, as accepted by the *_from functions
+ */
+enum ecl3_byteorders {
+    ECL3_BIG_ENDIAN = 1,
+    ECL3_LITTLE_ENDIAN,
+};
+
+/*
+ * The native (in-memory) types ecl3_get_native_as can output. Values are
+ * written with the host's byte order and layout.
+ */
+enum ecl3_native_types {
+    ECL3_NATIVE_INT32 = 1,
+    ECL3_NATIVE_INT64,
+    ECL3_NATIVE_FLOAT,
+    ECL3_NATIVE_DOUBLE,
+};
+
+/*
+ * An array found by ecl3_scan_arrays. The keyword and type are as on disk,
+ * i.e. space padded and not null terminated, and token is the keyword as
+ * packed by ecl3_keyword_token. Offsets are relative to the
+ * start of the scanned buffer, and point to the head record marker of the
+ * header and of the first body block respectively. body_size is the on-disk
+ * size of the body, record markers included, so the next array starts at
+ * body_offset + body_size.
+ */
+struct ecl3_array_entry {
+    char     keyword[8];
+    uint64_t token;
+    char     type[4];
+    int32_t  count;
+    int64_t  header_offset;
+    int64_t  body_offset;
+    int64_t  body_size;
+};
+
+/**
+ * Index the arrays in a buffer
+ *
+ * Walk the records in src, a buffer of size bytes that starts with an array
+ * header record, e.g. a memory mapped file, and describe each array in
+ * entries. This is all the record-marker handling an indexer needs, in a
+ * single call: the head and tail of every record, body blocks included, is
+ * checked, and the record lengths must match the blocking given by the
+ * header's count and type. The bodies are not decoded.
+ *
+ * order is one of enum ecl3_byteorders, and marker is the record marker size,
+ * 4 or 8, both as output by ecl3_detect_record_marker.
+ *
+ * Scanning stops when entries is full, i.e. after capacity arrays, or when
+ * the rest of the buffer does not hold a whole array. count is the number of
+ * arrays written to entries, and consumed the number of bytes they occupy,
+ * so that a buffer can be scanned in several calls, or a file in several
+ * windows, by continuing at src + consumed. When consumed == size, the whole
+ * buffer is scanned.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * ECL3_INVALID_ARGS
+ *    order or marker is invalid, or the array at src + consumed is broken,
+ *    i.e. it has mismatching head and tail, an unexpected record length, an
+ *    unknown type, or a negative count. count and consumed still describe
+ *    the arrays before it.
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Index a memory mapped file:
+ *
+ *     struct ecl3_array_entry entries[256];
+ *     size_t count, consumed, pos = 0;
+ *     int order, marker;
+ *     ecl3_detect_record_marker(data, &order, &marker);
+ *     do {
+ *         err = ecl3_scan_arrays(data + pos, size - pos, order, marker,
+ *                                entries, 256, &count, &consumed);
+ *         if (err) break;
+ *         index(entries, count, pos);
+ *         pos += consumed;
+ *     } while (count == 256);
+ */
+ECL3_API
+int ecl3_scan_arrays(const void* src,
+                     size_t size,
+                     int order,
+                     int marker,
+                     struct ecl3_array_entry* entries,
+                     size_t capacity,
+                     size_t* count,
+                     size_t* consumed);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
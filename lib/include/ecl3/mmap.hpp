@@ -0,0 +1,494 @@
+#ifndef ECL3_MMAP_HPP
+#define ECL3_MMAP_HPP
+
+#include <algorithm>
+#include <array>
+#include <ciso646>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <ecl3/io.hpp>
+#include <ecl3/keyword.h>
+
+namespace ecl3 {
+
+/*
+ * A view of a single block of an array body, i.e. the contents of one record,
+ * without the record markers. The data is in the file's byte order.
+ */
+struct block_view {
+    const unsigned char* data;
+    int count;
+};
+
+/*
+ * A view of an array in a memory-mapped file. Nothing is copied or decoded
+ * until asked for - the header is parsed, but the body is only a pointer into
+ * the mapping, and its record markers are not checked until the body is
+ * decoded or copied.
+ *
+ * The view is only valid as long as the mmap_reader it came from is alive.
+ */
+struct array_view {
+    std::array< char, 8 > keyword;
+    std::array< char, 4 > type;
+    std::int64_t count = 0;
+
+    /*
+     * The body, from the head of the first block to the tail of the last,
+     * laid out as on disk
+     */
+    const unsigned char* begin = nullptr;
+    const unsigned char* end = nullptr;
+
+    int typeid_ = 0;
+    int elemsize = 0;
+    int blocksize = 0;
+    int order = 0;
+    int marker = 0;
+
+    bool empty() const noexcept (true) { return this->count == -1; }
+
+    /*
+     * The number of blocks in the body, and the i-th block. Blocks are
+     * located by arithmetic, since all but the last block are full.
+     */
+    std::int64_t blocks() const noexcept (true);
+    block_view block(std::int64_t i) const noexcept (true);
+
+    /*
+     * Decode the body into dst, as by ecl3_array_body. dst must have space for
+     * count elements of type.
+     */
+    void decode(void* dst) const;
+
+    /*
+     * Decode and convert the body into dst, as by ecl3_get_native_as. dst
+     * must have space for count elements of the native type.
+     */
+    void decode_as(void* dst, int native) const;
+
+    /*
+     * Copy the body into dst, without the record markers and in the file's
+     * byte order.
+     */
+    void copy_raw(void* dst) const;
+
+private:
+    template < typename F >
+    void each_block(F&& f) const;
+};
+
+/*
+ * Read arrays from a memory-mapped file. The interface mirrors stream_reader,
+ * but next() returns views into the mapping instead of copies, so reading an
+ * array and skipping it is equally cheap.
+ *
+ * This is useful for files on local disks, that are read repeatedly or in
+ * random order. For pipes or network file systems, use stream_reader.
+ *
+ * Example
+ * -------
+ *  mmap_reader fs(path);
+ *  fs.advise(mmap_reader::sequential);
+ *  while (true) {
+ *      const auto& array = fs.next();
+ *      if (array.empty()) break;
+ *      if (interesting(array)) array.decode(dst);
+ *  }
+ */
+class mmap_reader {
+public:
+    explicit mmap_reader(const std::string& path);
+    ~mmap_reader();
+
+    mmap_reader(const mmap_reader&) = delete;
+    mmap_reader& operator=(const mmap_reader&) = delete;
+
+    /*
+     * Read the next array header. This updates the view in-place, but does not
+     * invalidate the data pointed to by previously-read views.
+     */
+    const array_view& next();
+    /*
+     * Unget the previously-read array, like stream_reader::unget()
+     */
+    void unget() noexcept (true);
+
+    std::uint64_t tell() const noexcept (true);
+    void seek(std::uint64_t offset) noexcept (true);
+
+    enum access {
+        normal,
+        sequential,
+        random,
+        willneed,
+    };
+
+    /*
+     * Hint the expected access pattern to the kernel, with madvise. Use
+     * sequential when reading through the whole file once, and random when
+     * reading arrays by offset, e.g. from a table of contents. This is only a
+     * hint, and is a no-op where not supported.
+     */
+    void advise(access pattern) noexcept (true);
+
+    int byteorder() const noexcept (true);
+    int record_marker_size() const noexcept (true);
+
+    const unsigned char* data() const noexcept (true);
+    std::uint64_t size() const noexcept (true);
+
+private:
+    const unsigned char* addr = nullptr;
+    std::uint64_t len = 0;
+    std::uint64_t pos = 0;
+
+    array_view last;
+    bool ungetted = false;
+    int order = 0;
+    int marker = 0;
+
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    void unmap() noexcept (true);
+};
+
+inline std::int64_t array_view::blocks() const noexcept (true) {
+    if (this->count <= 0) return 0;
+    return (this->count + this->blocksize - 1) / this->blocksize;
+}
+
+inline block_view array_view::block(std::int64_t i) const noexcept (true) {
+    const auto stride = std::int64_t(this->blocksize) * this->elemsize
+                      + 2 * this->marker
+                      ;
+    const auto first = i * this->blocksize;
+    block_view b;
+    b.data = this->begin + i * stride + this->marker;
+    b.count = int(std::min(this->count - first, std::int64_t(this->blocksize)));
+    return b;
+}
+
+template < typename F >
+void array_view::each_block(F&& f) const {
+    const auto n = this->blocks();
+    std::int64_t elems = 0;
+    for (std::int64_t i = 0; i < n; ++i) {
+        const auto b = this->block(i);
+        const auto* head = reinterpret_cast< const char* >(b.data)
+                         - this->marker;
+        const auto bytes = std::int64_t(b.count) * this->elemsize;
+        const auto* tail = reinterpret_cast< const char* >(b.data) + bytes;
+
+        check_headtail(head, tail, this->marker, this->order);
+        const auto len = record_length(head, this->marker, this->order);
+        if (len != bytes) {
+            std::stringstream ss;
+            ss << "unexpected record length (" << len << ")"
+               << ", expected " << bytes
+            ;
+            throw std::runtime_error(ss.str());
+        }
+
+        f(b, elems);
+        elems += b.count;
+    }
+}
+
+inline void array_view::decode(void* dst) const {
+    auto* out = static_cast< char* >(dst);
+    this->each_block([&](const block_view& b, std::int64_t elems) {
+        int count;
+        const auto err = ecl3_array_body_from(
+            out + elems * this->elemsize,
+            b.data,
+            this->typeid_,
+            this->count - elems,
+            this->blocksize,
+            &count,
+            this->order
+        );
+
+        if (err) {
+            throw std::runtime_error("error parsing array body");
+        }
+    });
+}
+
+inline void array_view::decode_as(void* dst, int native) const {
+    int nativesize;
+    switch (native) {
+        case ECL3_NATIVE_INT32:  nativesize = 4; break;
+        case ECL3_NATIVE_INT64:  nativesize = 8; break;
+        case ECL3_NATIVE_FLOAT:  nativesize = 4; break;
+        case ECL3_NATIVE_DOUBLE: nativesize = 8; break;
+        default:
+            throw std::invalid_argument("unknown native type");
+    }
+
+    auto* out = static_cast< char* >(dst);
+    this->each_block([&](const block_view& b, std::int64_t elems) {
+        const auto err = ecl3_get_native_as_from(
+            out + elems * nativesize,
+            b.data,
+            this->typeid_,
+            native,
+            b.count,
+            this->order
+        );
+
+        if (err) {
+            std::stringstream ss;
+            ss << "unable to convert "
+               << "'" << ecl3_type_name(this->typeid_) << "'"
+            ;
+            throw std::invalid_argument(ss.str());
+        }
+    });
+}
+
+inline void array_view::copy_raw(void* dst) const {
+    auto* out = static_cast< char* >(dst);
+    this->each_block([&](const block_view& b, std::int64_t elems) {
+        std::memcpy(out + elems * this->elemsize,
+                    b.data,
+                    std::size_t(b.count) * this->elemsize);
+    });
+}
+
+inline mmap_reader::mmap_reader(const std::string& path) {
+    const auto msg = "could not open file '" + path + "'";
+
+#if defined(_WIN32)
+    this->file = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+    if (this->file == INVALID_HANDLE_VALUE)
+        throw std::invalid_argument(msg);
+
+    LARGE_INTEGER size;
+    if (not GetFileSizeEx(this->file, &size)) {
+        this->unmap();
+        throw std::invalid_argument(msg);
+    }
+    this->len = std::uint64_t(size.QuadPart);
+
+    if (this->len > 0) {
+        this->mapping = CreateFileMappingA(
+            this->file, nullptr, PAGE_READONLY, 0, 0, nullptr
+        );
+        if (not this->mapping) {
+            this->unmap();
+            throw std::runtime_error("unable to map '" + path + "'");
+        }
+
+        const auto* p = MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (not p) {
+            this->unmap();
+            throw std::runtime_error("unable to map '" + path + "'");
+        }
+        this->addr = static_cast< const unsigned char* >(p);
+    }
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::invalid_argument(msg);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::invalid_argument(msg);
+    }
+    this->len = std::uint64_t(st.st_size);
+
+    /* mapping 0 bytes is an error, so an empty file is just a null mapping */
+    if (this->len > 0) {
+        auto* p = ::mmap(nullptr, this->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("unable to map '" + path + "'");
+        }
+        this->addr = static_cast< const unsigned char* >(p);
+    }
+
+    /* the mapping keeps the file alive */
+    ::close(fd);
+#endif
+}
+
+inline mmap_reader::~mmap_reader() {
+    this->unmap();
+}
+
+inline void mmap_reader::unmap() noexcept (true) {
+#if defined(_WIN32)
+    if (this->addr)    UnmapViewOfFile(this->addr);
+    if (this->mapping) CloseHandle(this->mapping);
+    if (this->file != INVALID_HANDLE_VALUE) CloseHandle(this->file);
+    this->mapping = nullptr;
+    this->file = INVALID_HANDLE_VALUE;
+#else
+    if (this->addr)
+        ::munmap(const_cast< unsigned char* >(this->addr), this->len);
+#endif
+    this->addr = nullptr;
+}
+
+inline const array_view& mmap_reader::next() {
+    if (this->ungetted) {
+        this->ungetted = false;
+        return this->last;
+    }
+
+    auto& x = this->last;
+    const auto remaining = this->len - this->pos;
+    if (remaining == 0) {
+        x.count = -1;
+        return x;
+    }
+
+    const auto* record = reinterpret_cast< const char* >(this->addr)
+                       + this->pos;
+
+    if (this->marker == 0) {
+        if (remaining < 8)
+            throw header_error("unexpected end-of-file in header");
+
+        const auto err = ecl3_detect_record_marker(
+            record,
+            &this->order,
+            &this->marker
+        );
+
+        if (err) {
+            throw header_error("unable to detect record marker from header");
+        }
+    }
+
+    const auto size = this->marker;
+    if (remaining < std::uint64_t(2 * size + 16))
+        throw header_error("unexpected end-of-file in header");
+
+    const auto* head   = record;
+    const auto* header = record + size;
+    const auto* tail   = record + size + 16;
+    check_headtail(head, tail, size, this->order);
+
+    int count;
+    auto err = ecl3_array_header_from(
+        header,
+        x.keyword.data(),
+        x.type.data(),
+        &count,
+        this->order
+    );
+
+    if (err) {
+        throw header_error("error parsing header");
+    }
+
+    err = ecl3_typeid(x.type.data(), &x.typeid_);
+    if (err) {
+        std::stringstream ss;
+        ss << "unknown type"
+           << "'"
+           << std::string(x.type.data(), x.type.size())
+           << "'"
+        ;
+        throw std::invalid_argument(ss.str());
+    }
+
+    const auto bodysize = body_size(x.typeid_, count, size);
+    const auto headsize = std::uint64_t(2 * size + 16);
+    if (remaining - headsize < bodysize)
+        throw std::runtime_error("unexpected end-of-file in array body");
+
+    ecl3_type_size(x.typeid_, &x.elemsize);
+    ecl3_block_size(x.typeid_, &x.blocksize);
+    x.count = count;
+    x.order = this->order;
+    x.marker = this->marker;
+    x.begin = this->addr + this->pos + headsize;
+    x.end = x.begin + bodysize;
+
+    this->pos += headsize + bodysize;
+    return x;
+}
+
+inline void mmap_reader::unget() noexcept (true) {
+    this->ungetted = true;
+}
+
+inline std::uint64_t mmap_reader::tell() const noexcept (true) {
+    return this->pos;
+}
+
+inline void mmap_reader::seek(std::uint64_t offset) noexcept (true) {
+    this->pos = std::min(offset, this->len);
+    this->ungetted = false;
+}
+
+inline void mmap_reader::advise(access pattern) noexcept (true) {
+#if defined(_WIN32)
+    (void) pattern;
+#else
+    if (not this->addr) return;
+
+    int advice = MADV_NORMAL;
+    switch (pattern) {
+        case normal:     advice = MADV_NORMAL;     break;
+        case sequential: advice = MADV_SEQUENTIAL; break;
+        case random:     advice = MADV_RANDOM;     break;
+        case willneed:   advice = MADV_WILLNEED;   break;
+    }
+
+    auto* p = const_cast< unsigned char* >(this->addr);
+    ::madvise(p, this->len, advice);
+#endif
+}
+
+inline int mmap_reader::byteorder() const noexcept (true) {
+    return this->order;
+}
+
+inline int mmap_reader::record_marker_size() const noexcept (true) {
+    return this->marker;
+}
+
+inline const unsigned char* mmap_reader::data() const noexcept (true) {
+    return this->addr;
+}
+
+inline std::uint64_t mmap_reader::size() const noexcept (true) {
+    return this->len;
+}
+
+}
+
+#endif // ECL3_MMAP_HPP
@@ -0,0 +1,344 @@
+#ifndef ECL3_PREFETCH_HPP
+#define ECL3_PREFETCH_HPP
+
+#include <algorithm>
+#include <ciso646>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ecl3/io.hpp>
+
+namespace ecl3 {
+
+/*
+ * A stream backend that reads ahead in a background thread. The thread reads
+ * fixed-size blocks of raw bytes from the underlying Stream into a bounded
+ * ring of depth blocks, while the consumer (stream_reader) decodes. This
+ * overlaps I/O with decoding, which matters on high-latency storage like
+ * network file systems.
+ *
+ * Memory use is bounded by depth * blocksize. When the ring is full, the
+ * thread waits for the consumer.
+ *
+ * Skipping within the read-ahead window is free, or waits for the thread
+ * like a read would. Seeking, or skipping past the window, stops the thread,
+ * repositions the underlying stream, and restarts reading from there. A
+ * prefetch_stream can only be opened once.
+ *
+ * Example
+ * -------
+ *  stream_reader< prefetch_stream< std::ifstream > > fs(path, depth);
+ */
+template < typename Stream >
+class prefetch_stream {
+public:
+    static constexpr std::size_t default_depth = 4;
+    static constexpr std::size_t default_blocksize = 1024 * 1024;
+
+    prefetch_stream() = default;
+    ~prefetch_stream();
+
+    prefetch_stream(const prefetch_stream&) = delete;
+    prefetch_stream& operator=(const prefetch_stream&) = delete;
+
+    void open(const std::string& path,
+              std::size_t depth = default_depth,
+              std::size_t blocksize = default_blocksize);
+
+    std::size_t read(char* dst, std::size_t n);
+    bool seekable() const noexcept (true);
+    void skip(std::uint64_t n);
+    std::uint64_t tell() const noexcept (true);
+    void seek(std::uint64_t offset);
+
+private:
+    using inner_traits = stream_traits< Stream >;
+
+    struct block {
+        uninitialized_vector< char > data;
+        std::size_t size = 0;
+    };
+
+    Stream inner;
+    std::vector< block > ring;
+    std::thread worker;
+
+    /*
+     * filled and consumed are running block counts, so the block at index i
+     * is ring[i % ring.size()]. The consumer reads from block consumed, and
+     * releases it by incrementing consumed. All of these are guarded by mtx.
+     */
+    std::mutex mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::uint64_t filled = 0;
+    std::uint64_t consumed = 0;
+    bool done = false;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    /* consumer state, only touched by the consumer thread */
+    bool current = false;
+    std::size_t pos = 0;
+    std::uint64_t offset = 0;
+    bool can_seek = false;
+
+    void start();
+    void stop() noexcept (true);
+    void run() noexcept (true);
+    bool acquire();
+    void release();
+};
+
+template < typename Stream >
+struct stream_traits< prefetch_stream< Stream > > {
+    template < typename... Args >
+    static void open(prefetch_stream< Stream >& s,
+                     const std::string& path,
+                     Args&&... args) {
+        s.open(path, std::forward< Args >(args)...);
+    }
+
+    static std::size_t read(prefetch_stream< Stream >& s,
+                            char* dst,
+                            std::size_t n) {
+        return s.read(dst, n);
+    }
+
+    static bool seekable(prefetch_stream< Stream >& s) noexcept (true) {
+        return s.seekable();
+    }
+
+    static void skip(prefetch_stream< Stream >& s, std::uint64_t n) {
+        s.skip(n);
+    }
+
+    static std::uint64_t tell(prefetch_stream< Stream >& s) noexcept (true) {
+        return s.tell();
+    }
+
+    static void seek(prefetch_stream< Stream >& s, std::uint64_t offset) {
+        s.seek(offset);
+    }
+};
+
+template < typename Stream >
+prefetch_stream< Stream >::~prefetch_stream() {
+    this->stop();
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::open(const std::string& path,
+                                     std::size_t depth,
+                                     std::size_t blocksize) {
+    if (depth == 0)
+        throw std::invalid_argument("read-ahead depth must be positive");
+    if (blocksize == 0)
+        throw std::invalid_argument("read-ahead blocksize must be positive");
+
+    /*
+     * The worker owns the underlying stream while running, so re-opening
+     * would have to stop it and re-open a stream that may not support it
+     */
+    if (not this->ring.empty())
+        throw std::logic_error("prefetch_stream is already open");
+
+    inner_traits::open(this->inner, path);
+
+    /*
+     * The underlying stream is owned by the worker thread once it is
+     * started, so probe it up front
+     */
+    this->can_seek = inner_traits::seekable(this->inner);
+
+    this->ring.resize(depth);
+    for (auto& b : this->ring)
+        b.data.resize(blocksize);
+
+    this->start();
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::start() {
+    this->filled = 0;
+    this->consumed = 0;
+    this->done = false;
+    this->stopping = false;
+    this->error = nullptr;
+    this->current = false;
+    this->pos = 0;
+    this->worker = std::thread(&prefetch_stream::run, this);
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::stop() noexcept (true) {
+    if (not this->worker.joinable()) return;
+
+    {
+        std::lock_guard< std::mutex > lock(this->mtx);
+        this->stopping = true;
+    }
+    this->not_full.notify_one();
+    this->worker.join();
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::run() noexcept (true) {
+    const auto depth = this->ring.size();
+    std::unique_lock< std::mutex > lock(this->mtx);
+    while (true) {
+        this->not_full.wait(lock, [this, depth] {
+            return this->stopping or this->filled - this->consumed < depth;
+        });
+        if (this->stopping) return;
+
+        auto& b = this->ring[this->filled % depth];
+        lock.unlock();
+
+        std::size_t got = 0;
+        std::exception_ptr err;
+        try {
+            auto* dst = b.data.data();
+            got = inner_traits::read(this->inner, dst, b.data.size());
+        } catch (...) {
+            err = std::current_exception();
+        }
+
+        lock.lock();
+        if (err) {
+            this->error = err;
+            this->done = true;
+        } else {
+            b.size = got;
+            ++this->filled;
+            this->done = got < b.data.size();
+        }
+
+        this->not_empty.notify_one();
+        if (this->done) return;
+    }
+}
+
+/*
+ * Make the next block current, waiting for the worker if it is not read yet.
+ * Returns false on end-of-file.
+ */
+template < typename Stream >
+bool prefetch_stream< Stream >::acquire() {
+    std::unique_lock< std::mutex > lock(this->mtx);
+    this->not_empty.wait(lock, [this] {
+        return this->done or this->filled > this->consumed;
+    });
+
+    if (this->filled > this->consumed) {
+        this->current = true;
+        this->pos = 0;
+        return true;
+    }
+
+    if (this->error)
+        std::rethrow_exception(this->error);
+
+    return false;
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::release() {
+    {
+        std::lock_guard< std::mutex > lock(this->mtx);
+        ++this->consumed;
+    }
+    this->current = false;
+    this->not_full.notify_one();
+}
+
+template < typename Stream >
+std::size_t prefetch_stream< Stream >::read(char* dst, std::size_t n) {
+    std::size_t done = 0;
+    while (done < n) {
+        if (not this->current and not this->acquire())
+            break;
+
+        const auto& b = this->ring[this->consumed % this->ring.size()];
+        const auto k = std::min(n - done, b.size - this->pos);
+        std::memcpy(dst + done, b.data.data() + this->pos, k);
+        this->pos += k;
+        done += k;
+
+        if (this->pos == b.size)
+            this->release();
+    }
+
+    this->offset += done;
+    return done;
+}
+
+template < typename Stream >
+bool prefetch_stream< Stream >::seekable() const noexcept (true) {
+    return this->can_seek;
+}
+
+/*
+ * Skips within the read-ahead window wait for the worker, like reads do, as
+ * it reads those blocks anyway. Only skips past the window reposition the
+ * underlying stream, which restarts the worker. Skipping past end-of-file
+ * means the file is truncated, and throws.
+ */
+template < typename Stream >
+void prefetch_stream< Stream >::skip(std::uint64_t n) {
+    const auto window = this->ring.size() * this->ring.front().data.size();
+    if (this->can_seek and n > window) {
+        /* seeking past end-of-file succeeds, so read the last skipped byte */
+        this->seek(this->offset + n - 1);
+        char last;
+        if (this->read(&last, 1) != 1)
+            throw std::runtime_error("unexpected end-of-file while skipping");
+        return;
+    }
+
+    while (n > 0) {
+        if (not this->current and not this->acquire())
+            throw std::runtime_error("unexpected end-of-file while skipping");
+
+        const auto& b = this->ring[this->consumed % this->ring.size()];
+        const auto k = std::min(n, std::uint64_t(b.size - this->pos));
+        this->pos += std::size_t(k);
+        this->offset += k;
+        n -= k;
+
+        if (this->pos == b.size)
+            this->release();
+    }
+}
+
+template < typename Stream >
+std::uint64_t prefetch_stream< Stream >::tell() const noexcept (true) {
+    return this->offset;
+}
+
+template < typename Stream >
+void prefetch_stream< Stream >::seek(std::uint64_t off) {
+    this->stop();
+
+    /* if repositioning fails, behave as end-of-file rather than hang */
+    this->current = false;
+    this->filled = this->consumed = 0;
+    this->done = true;
+
+    inner_traits::seek(this->inner, off);
+    this->offset = off;
+    this->start();
+}
+
+}
+
+#endif // ECL3_PREFETCH_HPP
@@ -0,0 +1,165 @@
+#ifndef ECL3_SMSPEC_HPP
+#define ECL3_SMSPEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ecl3/common.h>
+#include <ecl3/io.hpp>
+
+namespace ecl3 {
+
+/*
+ * A parsed summary specification (.SMSPEC), as a struct of arrays. The
+ * per-vector fields (keywords, wgnames, nums, ...) are NLIST long, and
+ * entry i of every field describes column i of the PARAMS.
+ *
+ * Strings are stripped of padding, and MEASRMNT, which is stored as several
+ * 8-character strings per vector, is joined into one string per vector. The
+ * small, non per-vector keywords (INTEHEAD, STARTDAT, RUNTIMEI, ...) are
+ * kept as their values, for the caller to interpret.
+ *
+ * Keywords that are not in the file are empty, and has() tells apart missing
+ * keywords from empty ones. Keywords that are not summary specification
+ * keywords are kept as-is in unhandled.
+ *
+ * Example
+ * -------
+ *  const auto spec = ecl3::read_smspec("CASE.SMSPEC");
+ *  for (std::int32_t i = 0; i < spec.nlist; ++i)
+ *      std::cout << spec.keywords[i] << ":" << spec.wgnames[i] << "\n";
+ */
+struct ECL3_API smspec {
+    /* DIMENS */
+    std::int32_t nlist = -1;
+    std::int32_t nx = 0;
+    std::int32_t ny = 0;
+    std::int32_t nz = 0;
+    std::int32_t istar = 0;
+    /* the raw DIMENS values, unused ones included */
+    std::vector< std::int32_t > dimens;
+
+    std::vector< std::string > keywords;
+    std::vector< std::string > wgnames;
+    std::vector< std::string > names;
+    std::vector< std::int32_t > nums;
+    std::vector< std::string > units;
+    std::vector< std::string > measurements;
+
+    std::vector< std::string > lgrs;
+    std::vector< std::int32_t > numlx;
+    std::vector< std::int32_t > numly;
+    std::vector< std::int32_t > numlz;
+
+    std::vector< float > lengths;
+    std::vector< float > xcoord;
+    std::vector< float > ycoord;
+
+    std::string restart;
+    std::string lenunits;
+    std::string step_reason;
+    std::vector< std::string > lgrnames;
+    std::vector< std::int32_t > lgrvec;
+    std::vector< std::int32_t > lgrtimes;
+
+    std::vector< std::int32_t > intehead;
+    std::vector< std::int32_t > startdat;
+    std::vector< std::int32_t > runtimei;
+    std::vector< double > runtimed;
+    std::vector< std::int32_t > timestamp;
+
+    std::vector< raw_array > unhandled;
+
+    /* The keywords found in the file, in file order */
+    std::vector< keyword_token > present;
+
+    bool has(keyword_token kw) const noexcept (true);
+
+    /*
+     * Parse a single keyword into the spec. DIMENS must come before
+     * MEASRMNT, like in the files. Throws invalid_type if the keyword has
+     * an unexpected type.
+     */
+    void update(const raw_array& x);
+};
+
+/*
+ * Read the specification from a file, which may be compressed, or from an
+ * in-memory copy of the file, in a single pass
+ */
+ECL3_API smspec read_smspec(const std::string& path);
+ECL3_API smspec read_smspec(const void* data, std::size_t size);
+
+/*
+ * The fully qualified column names of a summary, e.g. WOPR.OP_1, and their
+ * positions in PARAMS. Columns that are void, i.e. garbage, and duplicates
+ * are left out, so there can be fewer columns than vectors.
+ *
+ * The names are stored back to back in a single string, and name i is
+ * chars[offsets[i], offsets[i + 1]), so the whole set is three allocations
+ * regardless of the number of columns.
+ */
+struct ECL3_API columns {
+    std::string chars;
+    std::vector< std::size_t > offsets;
+    /* the position in PARAMS of column i */
+    std::vector< std::int32_t > pos;
+
+    std::size_t size() const noexcept (true);
+    std::string name(std::size_t i) const;
+};
+
+/*
+ * Resolve the column names from the per-vector identifiers. The keyword is
+ * qualified by the identifiers ecl3_params_classify says it needs, joined
+ * by separator. lgrs and numlx/y/z are optional and may be empty, but
+ * otherwise all arrays must be as long as keywords. Strings may be stripped
+ * or padded, and a blank or :+:+:+:+ string or negative number marks a
+ * void column.
+ *
+ * Duplicates are found with a hash set, so this is linear in the number of
+ * vectors.
+ *
+ * Example
+ * -------
+ *  const auto spec = ecl3::read_smspec("CASE.SMSPEC");
+ *  const auto cols = ecl3::resolve_columns(spec, ":");
+ *  for (std::size_t i = 0; i < cols.size(); ++i)
+ *      std::cout << cols.name(i) << " at " << cols.pos[i] << "\n";
+ */
+ECL3_API columns resolve_columns(const std::vector< std::string >& keywords,
+                                 const std::vector< std::string >& wgnames,
+                                 const std::vector< std::int32_t >& nums,
+                                 const std::vector< std::string >& lgrs,
+                                 const std::vector< std::int32_t >& numlx,
+                                 const std::vector< std::int32_t >& numly,
+                                 const std::vector< std::int32_t >& numlz,
+                                 const std::string& separator);
+
+inline columns resolve_columns(const smspec& spec,
+                               const std::string& separator) {
+    return resolve_columns(spec.keywords,
+                           spec.wgnames,
+                           spec.nums,
+                           spec.lgrs,
+                           spec.numlx,
+                           spec.numly,
+                           spec.numlz,
+                           separator);
+}
+
+template < typename Stream >
+smspec read_smspec(stream_reader< Stream >& fs) {
+    smspec spec;
+    while (true) {
+        const auto& x = fs.next();
+        if (x.empty()) return spec;
+        spec.update(x);
+    }
+}
+
+}
+
+#endif // ECL3_SMSPEC_HPP
@@ -1,6 +1,9 @@
 #ifndef ECL3_SUMMARY_H
 #define ECL3_SUMMARY_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <ecl3/common.h>
 
 #ifdef __cplusplus
@@ -238,6 +241,59 @@ int ecl3_params_identifies(const char* id, const char* keyword);
 ECL3_API
 const char** ecl3_params_partial_identifiers(void);
 
+/**
+ * Identifier categories, as bits in the masks of ecl3_params_classify
+ */
+enum ecl3_params_identifier_bits {
+    ECL3_PARAMS_WGNAMES = 1 << 0,
+    ECL3_PARAMS_NUMS    = 1 << 1,
+    ECL3_PARAMS_LGRS    = 1 << 2,
+    ECL3_PARAMS_NUMLX   = 1 << 3,
+    ECL3_PARAMS_NUMLY   = 1 << 4,
+    ECL3_PARAMS_NUMLZ   = 1 << 5,
+};
+
+/**
+ * Classify all the vectors of a summary specification at once
+ *
+ * This is the batch version of ecl3_params_identifies, for the whole KEYWORDS
+ * array. keywords is count 8-character keywords back to back, padded with
+ * spaces and not NULL terminated, i.e. the body of KEYWORDS. For every
+ * vector i, masks[i] is set to the ecl3_params_identifier_bits of the
+ * identifiers the vector depends on, and counts[i] to the number of
+ * identifiers needed to uniquely identify the vector, which is what
+ * ecl3_params_identifies returns for any of the identifiers in the mask.
+ *
+ * The rules are looked up in a table on the first character, and the few
+ * exceptions compared in place, so this does not allocate, and can classify
+ * large specifications in a single pass. counts can be NULL.
+ *
+ * **Returns**
+ * \rst
+ * ECL3_OK
+ *    Success
+ * ECL3_INVALID_ARGS
+ *    keywords or masks is NULL
+ * \endrst
+ *
+ * **Examples**
+ *
+ * Find the well vectors with void well names:
+ *
+ *     ecl3_params_classify(keywords, nlist, masks, NULL);
+ *     for (size_t i = 0; i < nlist; ++i) {
+ *         const char* wgname = wgnames + 8 * i;
+ *         if ((masks[i] & ECL3_PARAMS_WGNAMES)
+ *             && strncmp(wgname, ":+:+:+:+", 8) == 0)
+ *             printf("vector %zu is void\n", i);
+ *     }
+ */
+ECL3_API
+int ecl3_params_classify(const char* keywords,
+                         size_t count,
+                         uint8_t* masks,
+                         uint8_t* counts);
+
 enum ecl3_unit_systems {
     ECL3_METRIC = 1,
     ECL3_FIELD  = 2,
@@ -0,0 +1,143 @@
+#ifndef ECL3_THREAD_POOL_HPP
+#define ECL3_THREAD_POOL_HPP
+
+#include <atomic>
+#include <ciso646>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecl3 {
+
+/*
+ * A minimal, persistent pool of threads for data-parallel loops. There is no
+ * task queue - the pool runs one parallel_for at a time, and the calling
+ * thread takes part in the work, so a pool of n threads starts n - 1 workers.
+ *
+ * This is for splitting a single, large, CPU-bound job, like decoding a large
+ * array, and is not meant to be shared between unrelated callers.
+ */
+class thread_pool {
+public:
+    explicit thread_pool(unsigned threads);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /* The number of threads that run tasks, including the caller */
+    unsigned size() const noexcept (true);
+
+    /*
+     * Call f(i) for all i in [0, n), spread over the pool, and wait for all
+     * calls to finish. If any call throws, the remaining tasks are skipped,
+     * and the first exception is rethrown.
+     */
+    void parallel_for(std::size_t n, std::function< void (std::size_t) > f);
+
+private:
+    std::vector< std::thread > workers;
+
+    std::mutex mtx;
+    std::condition_variable start;
+    std::condition_variable done;
+    std::uint64_t generation = 0;
+    std::size_t active = 0;
+    bool stopping = false;
+
+    /* the current job, set before generation is bumped */
+    std::function< void (std::size_t) > task;
+    std::size_t ntasks = 0;
+    std::atomic< std::size_t > next;
+    std::exception_ptr error;
+
+    void run() noexcept (true);
+    void drain() noexcept (true);
+};
+
+inline thread_pool::thread_pool(unsigned threads) : next(0) {
+    for (unsigned i = 1; i < threads; ++i)
+        this->workers.emplace_back(&thread_pool::run, this);
+}
+
+inline thread_pool::~thread_pool() {
+    {
+        std::lock_guard< std::mutex > lock(this->mtx);
+        this->stopping = true;
+    }
+    this->start.notify_all();
+    for (auto& worker : this->workers)
+        worker.join();
+}
+
+inline unsigned thread_pool::size() const noexcept (true) {
+    return unsigned(this->workers.size()) + 1;
+}
+
+inline void thread_pool::parallel_for(std::size_t n,
+                                      std::function< void (std::size_t) > f) {
+    {
+        std::lock_guard< std::mutex > lock(this->mtx);
+        this->task = std::move(f);
+        this->ntasks = n;
+        this->next = 0;
+        this->error = nullptr;
+        this->active = this->workers.size();
+        ++this->generation;
+    }
+    this->start.notify_all();
+
+    this->drain();
+
+    std::unique_lock< std::mutex > lock(this->mtx);
+    this->done.wait(lock, [this] { return this->active == 0; });
+    this->task = nullptr;
+
+    if (this->error)
+        std::rethrow_exception(this->error);
+}
+
+inline void thread_pool::run() noexcept (true) {
+    std::uint64_t seen = 0;
+    std::unique_lock< std::mutex > lock(this->mtx);
+    while (true) {
+        this->start.wait(lock, [this, seen] {
+            return this->stopping or this->generation != seen;
+        });
+        if (this->stopping) return;
+
+        seen = this->generation;
+        lock.unlock();
+        this->drain();
+        lock.lock();
+
+        if (--this->active == 0)
+            this->done.notify_one();
+    }
+}
+
+inline void thread_pool::drain() noexcept (true) {
+    while (true) {
+        const auto i = this->next.fetch_add(1);
+        if (i >= this->ntasks) return;
+
+        try {
+            this->task(i);
+        } catch (...) {
+            std::lock_guard< std::mutex > lock(this->mtx);
+            if (not this->error)
+                this->error = std::current_exception();
+            /* make the other threads stop picking up tasks */
+            this->next = this->ntasks;
+        }
+    }
+}
+
+}
+
+#endif // ECL3_THREAD_POOL_HPP
@@ -0,0 +1,289 @@
+#ifndef ECL3_TOC_HPP
+#define ECL3_TOC_HPP
+
+#include <array>
+#include <ciso646>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include <ecl3/io.hpp>
+
+namespace ecl3 {
+
+/*
+ * An entry in the table of contents of a file - the header of an array, and
+ * the offset of the header record. Seeking a stream_reader to offset makes the
+ * next call to next() read this array.
+ */
+struct toc_entry {
+    std::array< char, 8 > keyword;
+    std::array< char, 4 > type;
+    std::int64_t count;
+    std::uint64_t offset;
+};
+
+/*
+ * The table of contents of a file, i.e. the list of all arrays in it, without
+ * their bodies. The byteorder and record_marker_size are the same as reported
+ * by stream_reader, and are 0 for empty files.
+ */
+struct toc {
+    int byteorder = 0;
+    int record_marker_size = 0;
+    std::vector< toc_entry > entries;
+};
+
+/*
+ * Build the table of contents of the file at path by reading only the array
+ * headers, and seeking past the bodies. This is very fast compared to reading
+ * the file, since only a few bytes per array is read.
+ */
+inline toc scan(const std::string& path) {
+    stream_reader< std::ifstream > fs(path);
+
+    toc t;
+    while (true) {
+        const auto offset = fs.tell();
+        const auto& x = fs.next_header();
+        if (x.empty()) break;
+
+        toc_entry e;
+        e.keyword = x.keyword;
+        e.type = x.type;
+        e.count = x.count;
+        e.offset = offset;
+        t.entries.push_back(e);
+    }
+
+    t.byteorder = fs.byteorder();
+    t.record_marker_size = fs.record_marker_size();
+    return t;
+}
+
+/*
+ * The table of contents can be persisted as a sidecar file, so that repeated
+ * opens of large files cost only a read of the sidecar. The sidecar records
+ * the size and modification time of the file it describes, and is considered
+ * stale if either has changed.
+ *
+ * The sidecar is a cache, local to a machine, and written in the host's byte
+ * order. Sidecars written on hosts with a different byte order are rejected.
+ *
+ * Layout:
+ *     magic       char[8]
+ *     bom         uint32   0x01020304
+ *     size        uint64
+ *     mtime       int64    nanoseconds since epoch, if available
+ *     byteorder   int32
+ *     marker      int32
+ *     entries     uint64
+ *     [keyword char[8], type char[4], count int64, offset uint64] * entries
+ */
+inline std::string toc_sidecar_path(const std::string& path) {
+    return path + ".ecl3toc";
+}
+
+namespace {
+
+constexpr const char toc_magic[8] = {
+    'E', 'C', 'L', '3', 'T', 'O', 'C', '1'
+};
+constexpr std::uint32_t toc_bom = 0x01020304;
+
+struct file_stamp {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+};
+
+bool stamp(const std::string& path, file_stamp& out) {
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(path.c_str(), &st) != 0) return false;
+    out.size = std::uint64_t(st.st_size);
+    out.mtime = std::int64_t(st.st_mtime) * 1000000000;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    out.size = std::uint64_t(st.st_size);
+    out.mtime = std::int64_t(st.st_mtime) * 1000000000;
+    #if defined(__APPLE__)
+        out.mtime += st.st_mtimespec.tv_nsec;
+    #elif defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L
+        out.mtime += st.st_mtim.tv_nsec;
+    #endif
+#endif
+    return true;
+}
+
+template < typename T >
+void write_pod(std::ostream& os, const T& x) {
+    os.write(reinterpret_cast< const char* >(&x), sizeof(x));
+}
+
+template < typename T >
+bool read_pod(std::istream& is, T& x) {
+    return bool(is.read(reinterpret_cast< char* >(&x), sizeof(x)));
+}
+
+/*
+ * A temporary name next to the sidecar, unique to this process and thread,
+ * so that concurrent writers don't write to the same file
+ */
+std::string toc_temporary_path(const std::string& sidecar) {
+#if defined(_WIN32)
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    const auto tid = std::hash< std::thread::id >()(std::this_thread::get_id());
+    return sidecar + "." + std::to_string(pid) + "-" + std::to_string(tid);
+}
+
+/*
+ * Write t to the sidecar of path, stamped with fst. The sidecar is written to
+ * a temporary file which is then renamed, so that readers never see a
+ * partially written sidecar.
+ */
+bool write_sidecar(const std::string& path,
+                   const toc& t,
+                   const file_stamp& fst) {
+    const auto sidecar = toc_sidecar_path(path);
+    const auto tmp = toc_temporary_path(sidecar);
+    std::ofstream os(tmp, std::ios::binary | std::ios::out);
+    if (not os) return false;
+
+    os.write(toc_magic, sizeof(toc_magic));
+    write_pod(os, toc_bom);
+    write_pod(os, fst.size);
+    write_pod(os, fst.mtime);
+    write_pod(os, std::int32_t(t.byteorder));
+    write_pod(os, std::int32_t(t.record_marker_size));
+    write_pod(os, std::uint64_t(t.entries.size()));
+    for (const auto& e : t.entries) {
+        os.write(e.keyword.data(), e.keyword.size());
+        os.write(e.type.data(), e.type.size());
+        write_pod(os, e.count);
+        write_pod(os, e.offset);
+    }
+
+    os.close();
+    if (os and std::rename(tmp.c_str(), sidecar.c_str()) == 0)
+        return true;
+
+#if defined(_WIN32)
+    /* rename does not replace existing files on windows */
+    if (os and std::remove(sidecar.c_str()) == 0
+           and std::rename(tmp.c_str(), sidecar.c_str()) == 0)
+        return true;
+#endif
+
+    std::remove(tmp.c_str());
+    return false;
+}
+
+}
+
+/*
+ * Write the table of contents t of the file at path to its sidecar. Returns
+ * false if the sidecar could not be written, e.g. in a read-only directory.
+ *
+ * The sidecar is stamped with the size and modification time of the file
+ * when write_toc is called, so t must describe the file as it is now. To
+ * cache a fresh scan, use load_toc, which stamps the file before scanning
+ * it, so that changes made during the scan make the sidecar stale.
+ */
+inline bool write_toc(const std::string& path, const toc& t) {
+    file_stamp fst;
+    if (not stamp(path, fst)) return false;
+    return write_sidecar(path, t, fst);
+}
+
+/*
+ * Read the table of contents of the file at path from its sidecar. Returns
+ * false if there is no sidecar, or if it is stale or broken, in which case t
+ * is left in an unspecified state.
+ */
+inline bool read_toc(const std::string& path, toc& t) {
+    file_stamp fst;
+    if (not stamp(path, fst)) return false;
+
+    std::ifstream is(toc_sidecar_path(path), std::ios::binary | std::ios::in);
+    if (not is) return false;
+
+    char magic[sizeof(toc_magic)];
+    if (not is.read(magic, sizeof(magic))) return false;
+    if (std::memcmp(magic, toc_magic, sizeof(magic)) != 0) return false;
+
+    std::uint32_t bom;
+    if (not read_pod(is, bom)) return false;
+    if (bom != toc_bom)        return false;
+
+    file_stamp recorded;
+    if (not read_pod(is, recorded.size))  return false;
+    if (not read_pod(is, recorded.mtime)) return false;
+    if (recorded.size != fst.size)   return false;
+    if (recorded.mtime != fst.mtime) return false;
+
+    std::int32_t byteorder;
+    std::int32_t marker;
+    std::uint64_t entries;
+    if (not read_pod(is, byteorder)) return false;
+    if (not read_pod(is, marker))    return false;
+    if (not read_pod(is, entries))   return false;
+
+    /* guard against garbage counts before allocating */
+    constexpr auto entry_size = 8 + 4 + 8 + 8;
+    if (entries > fst.size / entry_size) return false;
+
+    t.byteorder = byteorder;
+    t.record_marker_size = marker;
+    t.entries.resize(std::size_t(entries));
+    for (auto& e : t.entries) {
+        is.read(e.keyword.data(), e.keyword.size());
+        is.read(e.type.data(), e.type.size());
+        read_pod(is, e.count);
+        if (not read_pod(is, e.offset)) return false;
+    }
+
+    return true;
+}
+
+/*
+ * Get the table of contents of the file at path, from the sidecar if it is
+ * up-to-date, or by scanning the file otherwise. A fresh scan is persisted to
+ * the sidecar when possible, but failing to do so is not an error.
+ */
+inline toc load_toc(const std::string& path) {
+    toc t;
+    if (read_toc(path, t)) return t;
+
+    /*
+     * Stamp the file before scanning, so that if it changes during the scan,
+     * the sidecar is stale, rather than trusted with a fresh stamp
+     */
+    file_stamp fst;
+    const auto stamped = stamp(path, fst);
+    t = scan(path);
+    if (stamped)
+        write_sidecar(path, t, fst);
+    return t;
+}
+
+}
+
+#endif // ECL3_TOC_HPP
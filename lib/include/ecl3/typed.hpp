@@ -0,0 +1,509 @@
+#ifndef ECL3_TYPED_HPP
+#define ECL3_TYPED_HPP
+
+#include <algorithm>
+#include <array>
+#include <ciso646>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <ecl3/io.hpp>
+#include <ecl3/keyword.h>
+
+namespace ecl3 {
+
+/*
+ * A fixed-length string, as stored in CHAR and C0NN arrays, i.e. padded with
+ * spaces and not null terminated. It has the same layout as the on-disk
+ * string, so arrays of fixed_string can be read and copied in bulk.
+ */
+template < std::size_t N >
+struct fixed_string {
+    static_assert(N > 0 and N < 100, "fixed strings are 1-99 characters");
+
+    std::array< char, N > chars;
+
+    const char* data() const noexcept (true) { return this->chars.data(); }
+    static constexpr std::size_t size() noexcept (true) { return N; }
+    std::string str() const { return std::string(this->chars.data(), N); }
+};
+
+namespace {
+
+constexpr int c0nn_digits(int type) noexcept (true) {
+    return (((type >> 8) & 0xFF) - '0') * 10 + ((type & 0xFF) - '0');
+}
+
+constexpr bool is_c0nn_type(int type) noexcept (true) {
+    return (type & 0xFFFF0000) == (int('C') << 24 | int('0') << 16)
+       and c0nn_digits(type) > 0
+       ;
+}
+
+constexpr int c0nn_typeid(std::size_t n) noexcept (true) {
+    return int('C') << 24
+         | int('0') << 16
+         | int('0' + n / 10) << 8
+         | int('0' + n % 10)
+         ;
+}
+
+}
+
+/*
+ * Compile-time description of an array type: the C++ type its elements are
+ * read as (value_type), the representation on disk once byte-swapped
+ * (disk_type), and its size and blocking. value_type and disk_type only
+ * differ for LOGI, which is a 4-byte integer on disk.
+ *
+ * Only types that can be decoded have traits, so asking for e.g. MESS fails
+ * to compile.
+ *
+ * Example
+ * -------
+ *  using inte = ecl3::type_traits< ECL3_INTE >;
+ *  static_assert(std::is_same< inte::value_type, std::int32_t >::value, "");
+ */
+template < int Type, typename Value, typename Disk, int Blocksize >
+struct basic_type_traits {
+    using value_type = Value;
+    using disk_type  = Disk;
+
+    static constexpr int id = Type;
+    static constexpr int size = sizeof(Disk);
+    static constexpr int blocksize = Blocksize;
+
+    static value_type convert(disk_type x) noexcept (true) {
+        return value_type(x);
+    }
+};
+
+template < int Type, typename Enable = void >
+struct type_traits;
+
+template <>
+struct type_traits< ECL3_INTE > : basic_type_traits<
+    ECL3_INTE, std::int32_t, std::int32_t, ECL3_BLOCK_SIZE_NUMERIC
+> {};
+
+template <>
+struct type_traits< ECL3_REAL > : basic_type_traits<
+    ECL3_REAL, float, float, ECL3_BLOCK_SIZE_NUMERIC
+> {};
+
+template <>
+struct type_traits< ECL3_DOUB > : basic_type_traits<
+    ECL3_DOUB, double, double, ECL3_BLOCK_SIZE_NUMERIC
+> {};
+
+template <>
+struct type_traits< ECL3_LOGI > : basic_type_traits<
+    ECL3_LOGI, bool, std::int32_t, ECL3_BLOCK_SIZE_NUMERIC
+> {};
+
+template <>
+struct type_traits< ECL3_CHAR > : basic_type_traits<
+    ECL3_CHAR, fixed_string< 8 >, fixed_string< 8 >, ECL3_BLOCK_SIZE_STRING
+> {};
+
+template < int Type >
+struct type_traits< Type, typename std::enable_if<
+    is_c0nn_type(Type)
+>::type > : basic_type_traits<
+    Type,
+    fixed_string< c0nn_digits(Type) >,
+    fixed_string< c0nn_digits(Type) >,
+    ECL3_BLOCK_SIZE_STRING
+> {};
+
+/*
+ * The inverse of type_traits - the array type a C++ type is read from, and
+ * accepts(), which checks the type of an array at runtime. fixed_string< 8 >
+ * accepts both CHAR and C008.
+ */
+template < typename T >
+struct element_traits;
+
+template <>
+struct element_traits< std::int32_t > : type_traits< ECL3_INTE > {
+    static bool accepts(int type) noexcept (true) {
+        return type == ECL3_INTE;
+    }
+};
+
+template <>
+struct element_traits< float > : type_traits< ECL3_REAL > {
+    static bool accepts(int type) noexcept (true) {
+        return type == ECL3_REAL;
+    }
+};
+
+template <>
+struct element_traits< double > : type_traits< ECL3_DOUB > {
+    static bool accepts(int type) noexcept (true) {
+        return type == ECL3_DOUB;
+    }
+};
+
+template <>
+struct element_traits< bool > : type_traits< ECL3_LOGI > {
+    static bool accepts(int type) noexcept (true) {
+        return type == ECL3_LOGI;
+    }
+};
+
+template < std::size_t N >
+struct element_traits< fixed_string< N > >
+    : type_traits< N == 8 ? int(ECL3_CHAR) : c0nn_typeid(N) > {
+    static bool accepts(int type) noexcept (true) {
+        return type == c0nn_typeid(N) or (N == 8 and type == ECL3_CHAR);
+    }
+};
+
+namespace {
+
+template < typename T >
+void decode_typed(T* dst,
+                  const void* src,
+                  std::size_t n,
+                  int order,
+                  std::true_type) {
+    /* the element type is the disk type, so decode in place */
+    const auto id = element_traits< T >::id;
+    if (ecl3_get_native_from(dst, src, id, n, order))
+        throw std::invalid_argument("invalid byte order");
+}
+
+template < typename T >
+void decode_typed(T* dst,
+                  const void* src,
+                  std::size_t n,
+                  int order,
+                  std::false_type) {
+    /* convert through a buffer of the disk type, a block at a time */
+    using traits = element_traits< T >;
+    using disk_type = typename traits::disk_type;
+    std::array< disk_type, ECL3_BLOCK_SIZE_NUMERIC > tmp;
+
+    const auto* s = static_cast< const char* >(src);
+    while (n > 0) {
+        const auto k = std::min(n, tmp.size());
+        if (ecl3_get_native_from(tmp.data(), s, traits::id, k, order))
+            throw std::invalid_argument("invalid byte order");
+
+        for (std::size_t i = 0; i < k; ++i)
+            dst[i] = traits::convert(tmp[i]);
+
+        dst += k;
+        s += k * sizeof(disk_type);
+        n -= k;
+    }
+}
+
+}
+
+/*
+ * Decode n elements of an array body from their on-disk representation at
+ * src, in byte order order, into dst. The array type is given by T, and
+ * resolved at compile time. src must not contain record markers, i.e. it is
+ * a single block, or several blocks with the markers removed.
+ *
+ * Example
+ * -------
+ *  std::int32_t ministep;
+ *  ecl3::decode(&ministep, body, 1, ECL3_BIG_ENDIAN);
+ */
+template < typename T >
+void decode(T* dst, const void* src, std::size_t n, int order) {
+    using traits = element_traits< T >;
+    using disk_type = typename traits::disk_type;
+    static_assert(sizeof(disk_type) == std::size_t(traits::size),
+                  "disk_type must have the same layout as on disk");
+
+    using identity = std::is_same< T, disk_type >;
+    decode_typed(dst, src, n, order, identity());
+}
+
+/*
+ * A typed, read-only view of a decoded raw_array body, e.g.
+ *
+ *  ecl3::typed_array< float > params(fs.next());
+ *
+ * The type of the array is checked against T when the view is made, and a
+ * mismatch throws invalid_type, so the type is checked once per array, not
+ * in the loops over its elements. Types ecl3 cannot decode to fail to
+ * compile.
+ *
+ * The view does not own the body, and is only valid as long as the raw_array
+ * is. The body must be decoded, i.e. not read with raw_bodies.
+ *
+ * data() is the body as disk_type, which is T for all types but bool, whose
+ * elements are converted on access.
+ */
+template < typename T >
+class typed_array {
+public:
+    using traits = element_traits< T >;
+    using value_type = T;
+    using disk_type = typename traits::disk_type;
+
+    static_assert(sizeof(disk_type) == std::size_t(traits::size),
+                  "disk_type must have the same layout as on disk");
+
+    explicit typed_array(const raw_array& x);
+
+    std::size_t size() const noexcept (true) { return this->count; }
+    bool empty() const noexcept (true) { return this->count == 0; }
+    const disk_type* data() const noexcept (true);
+    value_type operator[](std::size_t i) const noexcept (true);
+
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        const_iterator(const typed_array* a, std::size_t i) : a(a), i(i) {}
+
+        T operator*() const noexcept (true) { return (*this->a)[this->i]; }
+        const_iterator& operator++() noexcept (true) {
+            ++this->i;
+            return *this;
+        }
+        const_iterator operator++(int) noexcept (true) {
+            auto tmp = *this;
+            ++this->i;
+            return tmp;
+        }
+
+        bool operator==(const const_iterator& o) const noexcept (true) {
+            return this->i == o.i;
+        }
+        bool operator!=(const const_iterator& o) const noexcept (true) {
+            return this->i != o.i;
+        }
+
+    private:
+        const typed_array* a;
+        std::size_t i;
+    };
+
+    const_iterator begin() const noexcept (true) { return { this, 0 }; }
+    const_iterator end() const noexcept (true) { return { this, this->count }; }
+
+private:
+    const unsigned char* body;
+    std::size_t count;
+};
+
+template < typename T >
+typed_array< T >::typed_array(const raw_array& x) {
+    int type;
+    const auto err = ecl3_typeid(x.type.data(), &type);
+    if (err or not traits::accepts(type)) {
+        std::stringstream ss;
+        ss << "array '" << std::string(x.keyword.data(), x.keyword.size())
+           << "' has type '" << std::string(x.type.data(), x.type.size())
+           << "', expected '" << ecl3_type_name(traits::id) << "'"
+        ;
+        throw invalid_type(ss.str());
+    }
+
+    const auto count = std::size_t(std::max< std::int64_t >(x.count, 0));
+    if (x.body.size() != count * sizeof(disk_type))
+        throw std::invalid_argument("array body does not match its count");
+
+    this->body = x.body.data();
+    this->count = count;
+}
+
+template < typename T >
+auto typed_array< T >::data() const noexcept (true) -> const disk_type* {
+    return reinterpret_cast< const disk_type* >(this->body);
+}
+
+template < typename T >
+T typed_array< T >::operator[](std::size_t i) const noexcept (true) {
+    disk_type x;
+    std::memcpy(&x, this->body + i * sizeof(disk_type), sizeof(x));
+    return traits::convert(x);
+}
+
+/*
+ * A LOGI array packed into a bitset, 1 bit per element instead of 4 bytes,
+ * with constant-time rank, e.g. to map a cell's global index to its index
+ * among the active cells.
+ *
+ * Since an element is true when it is non-zero, regardless of byte order, a
+ * bitset can be made from both decoded and raw bodies.
+ *
+ * The bitset can also be built incrementally with append(), e.g. from the
+ * chunks of stream_reader::next_chunked(), so that the 4-byte elements are
+ * never all in memory at once.
+ *
+ * Example
+ * -------
+ *  ecl3::logi_bitset active(fs.next());
+ *  const auto actives = active.count();
+ *  if (active[cell]) value = porv[active.rank(cell)];
+ *
+ * Pack a large array as it is read:
+ *
+ *  ecl3::logi_bitset active;
+ *  fs.next_chunked([&](const raw_array&,
+ *                      const unsigned char* data,
+ *                      std::int64_t,
+ *                      std::int64_t n) {
+ *      active.append(data, std::size_t(n));
+ *  }, 1000000);
+ */
+class logi_bitset {
+public:
+    logi_bitset() = default;
+    explicit logi_bitset(const raw_array& x);
+
+    /* Pack n LOGI elements at src, in any byte order */
+    void assign(const void* src, std::size_t n);
+
+    /*
+     * Pack n more LOGI elements at src, in any byte order, after the
+     * elements already in the bitset
+     */
+    void append(const void* src, std::size_t n);
+
+    std::size_t size() const noexcept (true) { return this->n; }
+    bool operator[](std::size_t i) const noexcept (true);
+
+    /* The number of true elements */
+    std::uint64_t count() const noexcept (true);
+
+    /* The number of true elements in [0, i), for i <= size() */
+    std::uint64_t rank(std::size_t i) const noexcept (true);
+
+    /* The packed words, in the layout of ecl3_pack_logi */
+    const std::vector< std::uint64_t >& words() const noexcept (true) {
+        return this->bits;
+    }
+
+private:
+    /* words per entry in the rank table */
+    static constexpr std::size_t stride = 8;
+
+    std::vector< std::uint64_t > bits;
+    /* ranks[k] is the number of set bits before word k * stride */
+    std::vector< std::uint64_t > ranks;
+    std::size_t n = 0;
+
+    /* recompute the rank table after the words from word onwards changed */
+    void update_ranks(std::size_t word);
+};
+
+inline logi_bitset::logi_bitset(const raw_array& x) {
+    int type;
+    const auto err = ecl3_typeid(x.type.data(), &type);
+    if (err or type != ECL3_LOGI) {
+        std::stringstream ss;
+        ss << "array '" << std::string(x.keyword.data(), x.keyword.size())
+           << "' has type '" << std::string(x.type.data(), x.type.size())
+           << "', expected 'LOGI'"
+        ;
+        throw invalid_type(ss.str());
+    }
+
+    const auto count = std::size_t(std::max< std::int64_t >(x.count, 0));
+    if (x.body.size() != count * sizeof(std::int32_t))
+        throw std::invalid_argument("array body does not match its count");
+
+    this->assign(x.body.data(), count);
+}
+
+inline void logi_bitset::assign(const void* src, std::size_t n) {
+    this->bits.clear();
+    this->ranks.clear();
+    this->n = 0;
+    this->append(src, n);
+}
+
+inline void logi_bitset::append(const void* src, std::size_t n) {
+    const auto first = this->n / 64;
+
+    if (this->n % 64 == 0) {
+        /* word aligned, so pack straight into the bitset */
+        this->bits.resize((this->n + n + 63) / 64);
+        ecl3_pack_logi(this->bits.data() + first, src, n);
+        this->n += n;
+        this->update_ranks(first);
+        return;
+    }
+
+    /*
+     * Pack a chunk at a time into a buffer, and shift it into place. The
+     * padding bits of the last word are zero, so ORing in is enough.
+     */
+    std::array< std::uint64_t, 64 > tmp;
+    const auto* p = static_cast< const char* >(src);
+    while (n > 0) {
+        const auto k = std::min(n, tmp.size() * 64);
+        ecl3_pack_logi(tmp.data(), p, k);
+
+        const auto shift = this->n % 64;
+        const auto at = this->n / 64;
+        this->n += k;
+        this->bits.resize((this->n + 63) / 64, 0);
+
+        const auto words = (k + 63) / 64;
+        for (std::size_t j = 0; j < words; ++j) {
+            this->bits[at + j] |= tmp[j] << shift;
+            if (shift != 0 and at + j + 1 < this->bits.size())
+                this->bits[at + j + 1] |= tmp[j] >> (64 - shift);
+        }
+
+        p += k * sizeof(std::int32_t);
+        n -= k;
+    }
+
+    this->update_ranks(first);
+}
+
+inline void logi_bitset::update_ranks(std::size_t word) {
+    /* entries up to and including the one covering word are unaffected */
+    const auto words = this->bits.size();
+    const auto from = this->ranks.empty() ? 0 : word / stride;
+    this->ranks.resize(words / stride + 1);
+
+    std::uint64_t acc = from == 0 ? 0 : this->ranks[from];
+    for (std::size_t k = from; k < this->ranks.size(); ++k) {
+        this->ranks[k] = acc;
+        const auto first = k * stride;
+        const auto len = std::min(std::size_t(stride), words - first);
+        acc += ecl3_popcount(this->bits.data() + first, len * 64);
+    }
+}
+
+inline bool logi_bitset::operator[](std::size_t i) const noexcept (true) {
+    return (this->bits[i / 64] >> (i % 64)) & 1;
+}
+
+inline std::uint64_t logi_bitset::count() const noexcept (true) {
+    return this->rank(this->n);
+}
+
+inline std::uint64_t logi_bitset::rank(std::size_t i) const noexcept (true) {
+    if (this->ranks.empty()) return 0;
+    const auto k = i / (stride * 64);
+    const auto* first = this->bits.data() + k * stride;
+    return this->ranks[k] + ecl3_popcount(first, i - k * stride * 64);
+}
+
+}
+
+#endif // ECL3_TYPED_HPP
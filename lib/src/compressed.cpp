@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <array>
+#include <ciso646>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <sys/types.h>
+#endif
+
+#if defined(ECL3_HAVE_ZLIB)
+    #include <zlib.h>
+#endif
+
+#if defined(ECL3_HAVE_ZSTD)
+    #include <zstd.h>
+#endif
+
+#include <ecl3/compressed.hpp>
+
+namespace ecl3 {
+
+namespace {
+
+int seek_file(std::FILE* fp, std::uint64_t offset) noexcept (true) {
+#if defined(_WIN32)
+    return _fseeki64(fp, static_cast< __int64 >(offset), SEEK_SET);
+#else
+    return fseeko(fp, static_cast< off_t >(offset), SEEK_SET);
+#endif
+}
+
+compression detect(const unsigned char* magic, std::size_t len) noexcept (true)
+{
+    static const unsigned char gzip[] = { 0x1F, 0x8B };
+    static const unsigned char zstd[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+    if (len >= sizeof(gzip) and std::memcmp(magic, gzip, sizeof(gzip)) == 0)
+        return compression::gzip;
+
+    if (len >= sizeof(zstd) and std::memcmp(magic, zstd, sizeof(zstd)) == 0)
+        return compression::zstd;
+
+    return compression::none;
+}
+
+const char* format_name(compression c) noexcept (true) {
+    switch (c) {
+        case compression::gzip: return "gzip";
+        case compression::zstd: return "zstd";
+        default:                return "uncompressed";
+    }
+}
+
+}
+
+struct compressed_stream::impl {
+    std::FILE* fp = nullptr;
+    compression format = compression::none;
+    /* the (decompressed) offset of the next byte returned by read() */
+    std::uint64_t pos = 0;
+
+    /* compressed input, [in_pos, in_len) is not yet consumed */
+    std::vector< unsigned char > in;
+    std::size_t in_pos = 0;
+    std::size_t in_len = 0;
+
+#if defined(ECL3_HAVE_ZLIB)
+    z_stream zs;
+    bool zs_init = false;
+#endif
+
+#if defined(ECL3_HAVE_ZSTD)
+    ZSTD_DStream* zds = nullptr;
+#endif
+
+    impl() : in(1024 * 1024) {}
+    ~impl();
+
+    void refill();
+    void reset();
+    std::size_t read(char* dst, std::size_t n);
+    std::size_t read_plain(char* dst, std::size_t n);
+    std::size_t read_gzip(char* dst, std::size_t n);
+    std::size_t read_zstd(char* dst, std::size_t n);
+    std::uint64_t discard(std::uint64_t n);
+};
+
+compressed_stream::impl::~impl() {
+#if defined(ECL3_HAVE_ZLIB)
+    if (this->zs_init) inflateEnd(&this->zs);
+#endif
+#if defined(ECL3_HAVE_ZSTD)
+    if (this->zds) ZSTD_freeDStream(this->zds);
+#endif
+    if (this->fp) std::fclose(this->fp);
+}
+
+void compressed_stream::impl::refill() {
+    this->in_pos = 0;
+    this->in_len = std::fread(this->in.data(), 1, this->in.size(), this->fp);
+    if (this->in_len == 0 and std::ferror(this->fp))
+        throw std::runtime_error("unable to read compressed file");
+}
+
+/*
+ * Reset the decompressor to the start of a stream, with the current input
+ * buffer as its first input
+ */
+void compressed_stream::impl::reset() {
+    switch (this->format) {
+        case compression::gzip: {
+#if defined(ECL3_HAVE_ZLIB)
+            auto& z = this->zs;
+            if (not this->zs_init) {
+                std::memset(&z, 0, sizeof(z));
+                /* 15 + 32: max window, and detect gzip or zlib header */
+                if (inflateInit2(&z, 15 + 32) != Z_OK)
+                    throw std::runtime_error("unable to initialise zlib");
+                this->zs_init = true;
+            } else {
+                inflateReset(&z);
+            }
+            z.next_in = this->in.data() + this->in_pos;
+            z.avail_in = static_cast< uInt >(this->in_len - this->in_pos);
+#endif
+            break;
+        }
+
+        case compression::zstd: {
+#if defined(ECL3_HAVE_ZSTD)
+            if (not this->zds) {
+                this->zds = ZSTD_createDStream();
+                if (not this->zds)
+                    throw std::runtime_error("unable to initialise zstd");
+            }
+            ZSTD_initDStream(this->zds);
+#endif
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+std::size_t compressed_stream::impl::read(char* dst, std::size_t n) {
+    std::size_t done = 0;
+    switch (this->format) {
+        case compression::gzip: done = this->read_gzip(dst, n); break;
+        case compression::zstd: done = this->read_zstd(dst, n); break;
+        default:                done = this->read_plain(dst, n); break;
+    }
+
+    this->pos += done;
+    return done;
+}
+
+std::size_t compressed_stream::impl::read_plain(char* dst, std::size_t n) {
+    /* the bytes read to detect the format are served first */
+    const auto buffered = std::min(n, this->in_len - this->in_pos);
+    std::memcpy(dst, this->in.data() + this->in_pos, buffered);
+    this->in_pos += buffered;
+
+    if (buffered == n) return n;
+
+    const auto rest = std::fread(dst + buffered, 1, n - buffered, this->fp);
+    if (rest < n - buffered and std::ferror(this->fp))
+        throw std::runtime_error("unable to read file");
+
+    return buffered + rest;
+}
+
+#if defined(ECL3_HAVE_ZLIB)
+
+std::size_t compressed_stream::impl::read_gzip(char* dst, std::size_t n) {
+    auto& z = this->zs;
+    std::size_t done = 0;
+    while (done < n) {
+        const auto chunk = std::min(n - done, std::size_t(UINT_MAX));
+        z.next_out = reinterpret_cast< Bytef* >(dst + done);
+        z.avail_out = static_cast< uInt >(chunk);
+
+        const auto err = inflate(&z, Z_NO_FLUSH);
+        done += chunk - z.avail_out;
+
+        if (err == Z_STREAM_END) {
+            /* there might be another member concatenated after this one */
+            inflateReset(&z);
+            continue;
+        }
+
+        if (err != Z_OK and err != Z_BUF_ERROR) {
+            auto msg = std::string("gzip decompression failed");
+            if (z.msg) msg += std::string(": ") + z.msg;
+            throw std::runtime_error(msg);
+        }
+
+        if (done == n) break;
+        if (z.avail_in > 0) continue;
+
+        this->refill();
+        z.next_in = this->in.data();
+        z.avail_in = static_cast< uInt >(this->in_len);
+        if (this->in_len > 0) continue;
+
+        /* end-of-file - fine between members, but not inside one */
+        if (z.total_in > 0)
+            throw std::runtime_error("unexpected end of gzip stream");
+        break;
+    }
+
+    return done;
+}
+
+#else
+
+std::size_t compressed_stream::impl::read_gzip(char*, std::size_t) {
+    throw std::logic_error("ecl3 is built without gzip support");
+}
+
+#endif
+
+#if defined(ECL3_HAVE_ZSTD)
+
+std::size_t compressed_stream::impl::read_zstd(char* dst, std::size_t n) {
+    std::size_t done = 0;
+    while (done < n) {
+        ZSTD_inBuffer src;
+        src.src = this->in.data();
+        src.size = this->in_len;
+        src.pos = this->in_pos;
+
+        ZSTD_outBuffer out;
+        out.dst = dst + done;
+        out.size = n - done;
+        out.pos = 0;
+
+        const auto ret = ZSTD_decompressStream(this->zds, &out, &src);
+        if (ZSTD_isError(ret)) {
+            auto msg = std::string("zstd decompression failed: ");
+            msg += ZSTD_getErrorName(ret);
+            throw std::runtime_error(msg);
+        }
+
+        this->in_pos = src.pos;
+        done += out.pos;
+
+        /*
+         * If the output is not full, the decoder has flushed all it can with
+         * the input it has, and needs more
+         */
+        if (done == n) break;
+        if (this->in_pos < this->in_len) continue;
+
+        this->refill();
+        if (this->in_len > 0) continue;
+
+        /* end-of-file - fine between frames, but not inside one */
+        if (ret != 0)
+            throw std::runtime_error("unexpected end of zstd stream");
+        break;
+    }
+
+    return done;
+}
+
+#else
+
+std::size_t compressed_stream::impl::read_zstd(char*, std::size_t) {
+    throw std::logic_error("ecl3 is built without zstd support");
+}
+
+#endif
+
+/*
+ * Read and throw away up to n bytes, and return how many there were, which is
+ * fewer than n only at end-of-file
+ */
+std::uint64_t compressed_stream::impl::discard(std::uint64_t n) {
+    std::array< char, 64 * 1024 > sink;
+    std::uint64_t done = 0;
+    while (done < n) {
+        const auto k = std::min< std::uint64_t >(n - done, sink.size());
+        const auto got = this->read(sink.data(), k);
+        if (got == 0) break;
+        done += got;
+    }
+    return done;
+}
+
+compressed_stream::compressed_stream() = default;
+compressed_stream::~compressed_stream() = default;
+
+void compressed_stream::open(const std::string& path) {
+    auto x = std::unique_ptr< impl >(new impl());
+    x->fp = std::fopen(path.c_str(), "rb");
+    if (not x->fp) {
+        const auto msg = "could not open file '" + path + "'";
+        throw std::invalid_argument(msg);
+    }
+
+    x->refill();
+    x->format = detect(x->in.data(), x->in_len);
+    if (not compressed_stream::supports(x->format)) {
+        auto msg = "unable to read '" + path + "': ";
+        msg += "ecl3 is built without ";
+        msg += format_name(x->format);
+        msg += " support";
+        throw std::invalid_argument(msg);
+    }
+
+    x->reset();
+    this->p = std::move(x);
+}
+
+std::size_t compressed_stream::read(char* dst, std::size_t n) {
+    return this->p->read(dst, n);
+}
+
+bool compressed_stream::seekable() const noexcept (true) {
+    return this->p->format == compression::none;
+}
+
+void compressed_stream::skip(std::uint64_t n) {
+    if (n == 0) return;
+
+    /*
+     * Skipping past end-of-file means the file is truncated. Seeking past
+     * the end of a plain file succeeds, so read the last skipped byte to
+     * detect it
+     */
+    auto& x = *this->p;
+    if (this->seekable()) {
+        this->seek(x.pos + n - 1);
+        char last;
+        if (x.read(&last, 1) == 1) return;
+    } else if (x.discard(n) == n) {
+        return;
+    }
+
+    throw std::runtime_error("unexpected end-of-file while skipping");
+}
+
+std::uint64_t compressed_stream::tell() const noexcept (true) {
+    return this->p->pos;
+}
+
+void compressed_stream::seek(std::uint64_t offset) {
+    auto& x = *this->p;
+
+    if (x.format == compression::none) {
+        if (seek_file(x.fp, offset) != 0)
+            throw std::runtime_error("unable to seek");
+
+        x.in_pos = x.in_len = 0;
+        x.pos = offset;
+        return;
+    }
+
+    if (offset < x.pos) {
+        /* compressed streams can only be rewound by starting over */
+        if (seek_file(x.fp, 0) != 0)
+            throw std::runtime_error("unable to rewind compressed stream");
+
+        x.refill();
+        x.reset();
+        x.pos = 0;
+    }
+
+    x.discard(offset - x.pos);
+}
+
+compression compressed_stream::format() const noexcept (true) {
+    return this->p->format;
+}
+
+bool compressed_stream::supports(compression format) noexcept (true) {
+    switch (format) {
+        case compression::none:
+            return true;
+
+        case compression::gzip:
+#if defined(ECL3_HAVE_ZLIB)
+            return true;
+#else
+            return false;
+#endif
+
+        case compression::zstd:
+#if defined(ECL3_HAVE_ZSTD)
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+}
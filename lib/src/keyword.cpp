@@ -4,14 +4,30 @@
 #include <ciso646>
 #include <cstdint>
 #include <cstring>
+#include <type_traits>
 
 #include <endianness/endianness.h>
 
 #include <ecl3/keyword.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define ECL3_X86_KERNELS
+    #define ECL3_TARGET(isa) __attribute__ ((target (isa)))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define ECL3_X86_KERNELS
+    #define ECL3_TARGET(isa)
+    #include <intrin.h>
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define ECL3_NEON_KERNELS
+    #include <arm_neon.h>
+#endif
+
 namespace {
 
-void memcpy_bswap32(void* d, const void* s, std::size_t nmemb) noexcept (true) {
+void memcpy_bswap32_scalar(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
     std::uint32_t tmp;
     auto* dst = reinterpret_cast< char* >(d);
     auto* src = reinterpret_cast< const char* >(s);
@@ -24,7 +40,8 @@ void memcpy_bswap32(void* d, const void* s, std::size_t nmemb) noexcept (true) {
     }
 }
 
-void memcpy_bswap64(void* d, const void* s, std::size_t nmemb) noexcept (true) {
+void memcpy_bswap64_scalar(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
     std::uint64_t tmp;
     auto* dst = reinterpret_cast< char* >(d);
     auto* src = reinterpret_cast< const char* >(s);
@@ -37,42 +54,659 @@ void memcpy_bswap64(void* d, const void* s, std::size_t nmemb) noexcept (true) {
     }
 }
 
-#if defined(ENDIANNESS_BIG_ENDIAN)
-void memcpy_msb32(void* dst, const void* src, std::size_t nmemb) noexcept (true) {
-    if (dst == src) return;
-    std::memcpy(dst, src, nmemb * sizeof(std::uint32_t));
+std::uint32_t swap_word(std::uint32_t x) noexcept (true) { return bswap32(x); }
+std::uint64_t swap_word(std::uint64_t x) noexcept (true) { return bswap64(x); }
+
+/*
+ * Read on-disk Src values, and write them as native Dst values. Swap is true
+ * when the on-disk byte order differs from the host's.
+ */
+template < typename Src, typename Dst, bool Swap >
+void convert_scalar(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    using word = typename std::conditional<
+        sizeof(Src) == sizeof(std::uint32_t),
+        std::uint32_t,
+        std::uint64_t
+    >::type;
+    static_assert(sizeof(Src) == sizeof(word), "Src must be 4 or 8 bytes");
+
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    for (std::size_t i = 0; i < nmemb; ++i) {
+        word tmp;
+        std::memcpy(&tmp, src, sizeof(tmp));
+        if (Swap) tmp = swap_word(tmp);
+        Src x;
+        std::memcpy(&x, &tmp, sizeof(x));
+        const auto y = static_cast< Dst >(x);
+        std::memcpy(dst, &y, sizeof(y));
+        dst += sizeof(Dst);
+        src += sizeof(Src);
+    }
 }
 
-void memcpy_msb64(void* dst, const void* src, std::size_t nmemb) noexcept (true) {
-    if (dst == src) return;
-    std::memcpy(dst, src, nmemb * sizeof(std::uint64_t));
+/*
+ * Vectorised byte swap kernels
+ *
+ * All kernels swap as many elements as fits in whole registers, and leave the
+ * tail to the scalar implementation. Every iteration loads a full register
+ * before storing it, so dst == src (in-place swapping) is fine, but partially
+ * overlapping buffers are not, just like memcpy.
+ *
+ * The x86 kernels are compiled for their target ISA regardless of the flags
+ * the rest of the library is compiled with, and must only be called after
+ * checking that the CPU supports it. This is done once, on first use, see
+ * select_kernels().
+ */
+#if defined(ECL3_X86_KERNELS)
+
+ECL3_TARGET("ssse3")
+void memcpy_bswap32_ssse3(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m128i) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m128i* >(src);
+        auto* d = reinterpret_cast< __m128i* >(dst);
+        _mm_storeu_si128(d, _mm_shuffle_epi8(_mm_loadu_si128(s), mask));
+        src += sizeof(__m128i);
+        dst += sizeof(__m128i);
+    }
+    memcpy_bswap32_scalar(dst, src, nmemb - i);
 }
 
-#elif defined(ENDIANNESS_LITTLE_ENDIAN)
-void memcpy_msb32(void* dst, const void* src, std::size_t nmemb) noexcept (true) {
-    memcpy_bswap32(dst, src, nmemb);
+ECL3_TARGET("ssse3")
+void memcpy_bswap64_ssse3(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
+    );
+
+    constexpr std::size_t lanes = sizeof(__m128i) / sizeof(std::uint64_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m128i* >(src);
+        auto* d = reinterpret_cast< __m128i* >(dst);
+        _mm_storeu_si128(d, _mm_shuffle_epi8(_mm_loadu_si128(s), mask));
+        src += sizeof(__m128i);
+        dst += sizeof(__m128i);
+    }
+    memcpy_bswap64_scalar(dst, src, nmemb - i);
+}
+
+ECL3_TARGET("avx2")
+void memcpy_bswap32_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    /* vpshufb shuffles within 128-bit lanes, so repeat the mask per lane */
+    const auto mask = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m256i) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m256i* >(src);
+        auto* d = reinterpret_cast< __m256i* >(dst);
+        _mm256_storeu_si256(d, _mm256_shuffle_epi8(_mm256_loadu_si256(s), mask));
+        src += sizeof(__m256i);
+        dst += sizeof(__m256i);
+    }
+    memcpy_bswap32_ssse3(dst, src, nmemb - i);
+}
+
+ECL3_TARGET("avx2")
+void memcpy_bswap64_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm256_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
+    );
+
+    constexpr std::size_t lanes = sizeof(__m256i) / sizeof(std::uint64_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m256i* >(src);
+        auto* d = reinterpret_cast< __m256i* >(dst);
+        _mm256_storeu_si256(d, _mm256_shuffle_epi8(_mm256_loadu_si256(s), mask));
+        src += sizeof(__m256i);
+        dst += sizeof(__m256i);
+    }
+    memcpy_bswap64_ssse3(dst, src, nmemb - i);
 }
 
-void memcpy_msb64(void* dst, const void* src, std::size_t nmemb) noexcept (true) {
-    memcpy_bswap64(dst, src, nmemb);
+ECL3_TARGET("avx512f,avx512bw")
+void memcpy_bswap32_avx512(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm512_broadcast_i32x4(_mm_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    ));
+
+    constexpr std::size_t lanes = sizeof(__m512i) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto x = _mm512_loadu_si512(src);
+        _mm512_storeu_si512(dst, _mm512_shuffle_epi8(x, mask));
+        src += sizeof(__m512i);
+        dst += sizeof(__m512i);
+    }
+    memcpy_bswap32_avx2(dst, src, nmemb - i);
 }
 
+ECL3_TARGET("avx512f,avx512bw")
+void memcpy_bswap64_avx512(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm512_broadcast_i32x4(_mm_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
+    ));
+
+    constexpr std::size_t lanes = sizeof(__m512i) / sizeof(std::uint64_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto x = _mm512_loadu_si512(src);
+        _mm512_storeu_si512(dst, _mm512_shuffle_epi8(x, mask));
+        src += sizeof(__m512i);
+        dst += sizeof(__m512i);
+    }
+    memcpy_bswap64_avx2(dst, src, nmemb - i);
+}
+
+/*
+ * Converting kernels swap and widen (or narrow) in the same pass, so the
+ * swapped values are never written back to memory in their on-disk width.
+ * When the file already is in host byte order, the shuffle is skipped.
+ */
+template < bool Swap >
+ECL3_TARGET("avx2")
+void convert_inte_int64_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m128i) / sizeof(std::int32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m128i* >(src);
+        auto* d = reinterpret_cast< __m256i* >(dst);
+        auto x = _mm_loadu_si128(s);
+        if (Swap) x = _mm_shuffle_epi8(x, mask);
+        _mm256_storeu_si256(d, _mm256_cvtepi32_epi64(x));
+        src += lanes * sizeof(std::int32_t);
+        dst += lanes * sizeof(std::int64_t);
+    }
+    convert_scalar< std::int32_t, std::int64_t, Swap >(dst, src, nmemb - i);
+}
+
+template < bool Swap >
+ECL3_TARGET("avx2")
+void convert_inte_float_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m256i) / sizeof(std::int32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m256i* >(src);
+        auto* d = reinterpret_cast< float* >(dst);
+        auto x = _mm256_loadu_si256(s);
+        if (Swap) x = _mm256_shuffle_epi8(x, mask);
+        _mm256_storeu_ps(d, _mm256_cvtepi32_ps(x));
+        src += lanes * sizeof(std::int32_t);
+        dst += lanes * sizeof(float);
+    }
+    convert_scalar< std::int32_t, float, Swap >(dst, src, nmemb - i);
+}
+
+template < bool Swap >
+ECL3_TARGET("avx2")
+void convert_inte_double_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m128i) / sizeof(std::int32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m128i* >(src);
+        auto* d = reinterpret_cast< double* >(dst);
+        auto x = _mm_loadu_si128(s);
+        if (Swap) x = _mm_shuffle_epi8(x, mask);
+        _mm256_storeu_pd(d, _mm256_cvtepi32_pd(x));
+        src += lanes * sizeof(std::int32_t);
+        dst += lanes * sizeof(double);
+    }
+    convert_scalar< std::int32_t, double, Swap >(dst, src, nmemb - i);
+}
+
+template < bool Swap >
+ECL3_TARGET("avx2")
+void convert_real_double_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    );
+
+    constexpr std::size_t lanes = sizeof(__m128) / sizeof(float);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m128i* >(src);
+        auto* d = reinterpret_cast< double* >(dst);
+        auto x = _mm_loadu_si128(s);
+        if (Swap) x = _mm_shuffle_epi8(x, mask);
+        _mm256_storeu_pd(d, _mm256_cvtps_pd(_mm_castsi128_ps(x)));
+        src += lanes * sizeof(float);
+        dst += lanes * sizeof(double);
+    }
+    convert_scalar< float, double, Swap >(dst, src, nmemb - i);
+}
+
+template < bool Swap >
+ECL3_TARGET("avx2")
+void convert_doub_float_avx2(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< char* >(d);
+    auto* src = reinterpret_cast< const char* >(s);
+    const auto mask = _mm256_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7
+    );
+
+    constexpr std::size_t lanes = sizeof(__m256d) / sizeof(double);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        const auto* s = reinterpret_cast< const __m256i* >(src);
+        auto* d = reinterpret_cast< float* >(dst);
+        auto x = _mm256_loadu_si256(s);
+        if (Swap) x = _mm256_shuffle_epi8(x, mask);
+        _mm_storeu_ps(d, _mm256_cvtpd_ps(_mm256_castsi256_pd(x)));
+        src += lanes * sizeof(double);
+        dst += lanes * sizeof(float);
+    }
+    convert_scalar< double, float, Swap >(dst, src, nmemb - i);
+}
+
+#elif defined(ECL3_NEON_KERNELS)
+
+void memcpy_bswap32_neon(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< std::uint8_t* >(d);
+    auto* src = reinterpret_cast< const std::uint8_t* >(s);
+
+    constexpr std::size_t lanes = sizeof(uint8x16_t) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        vst1q_u8(dst, vrev32q_u8(vld1q_u8(src)));
+        src += sizeof(uint8x16_t);
+        dst += sizeof(uint8x16_t);
+    }
+    memcpy_bswap32_scalar(dst, src, nmemb - i);
+}
+
+void memcpy_bswap64_neon(void* d, const void* s, std::size_t nmemb)
+noexcept (true) {
+    auto* dst = reinterpret_cast< std::uint8_t* >(d);
+    auto* src = reinterpret_cast< const std::uint8_t* >(s);
+
+    constexpr std::size_t lanes = sizeof(uint8x16_t) / sizeof(std::uint64_t);
+    std::size_t i = 0;
+    for (; i + lanes <= nmemb; i += lanes) {
+        vst1q_u8(dst, vrev64q_u8(vld1q_u8(src)));
+        src += sizeof(uint8x16_t);
+        dst += sizeof(uint8x16_t);
+    }
+    memcpy_bswap64_scalar(dst, src, nmemb - i);
+}
+
+#endif
+
+/*
+ * LOGI packing and popcount kernels
+ *
+ * A logical is true when its 4-byte on-disk value is non-zero, which is the
+ * same in both byte orders, so packing needs no byte swap. Bits are packed
+ * little-end first, i.e. element i is bit i % 64 of word i / 64, and the
+ * unused bits of the last word are zero.
+ */
+void pack_logi_scalar(std::uint64_t* dst, const void* s, std::size_t nmemb)
+noexcept (true) {
+    const auto* src = reinterpret_cast< const char* >(s);
+    for (std::size_t i = 0; i < nmemb; i += 64) {
+        const auto n = std::min(nmemb - i, std::size_t(64));
+        std::uint64_t word = 0;
+        for (std::size_t k = 0; k < n; ++k) {
+            std::uint32_t x;
+            std::memcpy(&x, src + (i + k) * sizeof(x), sizeof(x));
+            word |= std::uint64_t(x != 0) << k;
+        }
+        *dst++ = word;
+    }
+}
+
+inline std::uint64_t popcount64(std::uint64_t x) noexcept (true) {
+#if defined(__GNUC__)
+    return std::uint64_t(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (x * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+std::uint64_t popcount_scalar(const std::uint64_t* words, std::size_t n)
+noexcept (true) {
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        count += popcount64(words[i]);
+    return count;
+}
+
+#if defined(ECL3_X86_KERNELS)
+
+/*
+ * Compare a register of logicals to zero, and collect the sign bits of the
+ * lanes with movemask. The lanes that compare equal to zero are false, so the
+ * mask is inverted.
+ */
+ECL3_TARGET("sse2")
+void pack_logi_sse2(std::uint64_t* dst, const void* s, std::size_t nmemb)
+noexcept (true) {
+    const auto* src = reinterpret_cast< const char* >(s);
+    const auto zero = _mm_setzero_si128();
+
+    constexpr std::size_t lanes = sizeof(__m128i) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + 64 <= nmemb; i += 64) {
+        std::uint64_t word = 0;
+        for (std::size_t k = 0; k < 64; k += lanes) {
+            const auto* p = reinterpret_cast< const __m128i* >(src);
+            const auto eq = _mm_cmpeq_epi32(_mm_loadu_si128(p), zero);
+            const auto m = _mm_movemask_ps(_mm_castsi128_ps(eq));
+            word |= std::uint64_t(~m & 0xF) << k;
+            src += sizeof(__m128i);
+        }
+        *dst++ = word;
+    }
+    pack_logi_scalar(dst, src, nmemb - i);
+}
+
+ECL3_TARGET("avx2")
+void pack_logi_avx2(std::uint64_t* dst, const void* s, std::size_t nmemb)
+noexcept (true) {
+    const auto* src = reinterpret_cast< const char* >(s);
+    const auto zero = _mm256_setzero_si256();
+
+    constexpr std::size_t lanes = sizeof(__m256i) / sizeof(std::uint32_t);
+    std::size_t i = 0;
+    for (; i + 64 <= nmemb; i += 64) {
+        std::uint64_t word = 0;
+        for (std::size_t k = 0; k < 64; k += lanes) {
+            const auto* p = reinterpret_cast< const __m256i* >(src);
+            const auto eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(p), zero);
+            const auto m = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+            word |= std::uint64_t(~m & 0xFF) << k;
+            src += sizeof(__m256i);
+        }
+        *dst++ = word;
+    }
+    pack_logi_scalar(dst, src, nmemb - i);
+}
+
+/*
+ * With the popcnt target, the compiler emits the popcnt instruction for
+ * popcount64, rather than a table or bit tricks
+ */
+ECL3_TARGET("popcnt")
+std::uint64_t popcount_popcnt(const std::uint64_t* words, std::size_t n)
+noexcept (true) {
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        count += popcount64(words[i]);
+    return count;
+}
+
+#endif
+
+using kernel = void (*)(void*, const void*, std::size_t);
+
+struct convert_kernels {
+    kernel inte_int64;
+    kernel inte_float;
+    kernel inte_double;
+    kernel real_double;
+    kernel doub_float;
+};
+
+template < bool Swap >
+convert_kernels scalar_converters() noexcept (true) {
+    convert_kernels k;
+    k.inte_int64  = convert_scalar< std::int32_t, std::int64_t, Swap >;
+    k.inte_float  = convert_scalar< std::int32_t, float, Swap >;
+    k.inte_double = convert_scalar< std::int32_t, double, Swap >;
+    k.real_double = convert_scalar< float, double, Swap >;
+    k.doub_float  = convert_scalar< double, float, Swap >;
+    return k;
+}
+
+#if defined(ECL3_X86_KERNELS)
+template < bool Swap >
+convert_kernels avx2_converters() noexcept (true) {
+    convert_kernels k;
+    k.inte_int64  = convert_inte_int64_avx2< Swap >;
+    k.inte_float  = convert_inte_float_avx2< Swap >;
+    k.inte_double = convert_inte_double_avx2< Swap >;
+    k.real_double = convert_real_double_avx2< Swap >;
+    k.doub_float  = convert_doub_float_avx2< Swap >;
+    return k;
+}
+#endif
+
+struct decode_kernels {
+    kernel swap32;
+    kernel swap64;
+
+    void (*pack_logi)(std::uint64_t*, const void*, std::size_t);
+    std::uint64_t (*popcount)(const std::uint64_t*, std::size_t);
+
+    /* for files in foreign and host byte order, respectively */
+    convert_kernels swapped;
+    convert_kernels unswapped;
+};
+
+#if defined(ECL3_X86_KERNELS)
+
+enum class isa { scalar, ssse3, avx2, avx512 };
+
+isa cpu_isa() noexcept (true) {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    const int maxleaf = regs[0];
+
+    __cpuid(regs, 1);
+    const bool ssse3   = regs[2] & (1 << 9);
+    const bool osxsave = regs[2] & (1 << 27);
+    if (!ssse3) return isa::scalar;
+    if (!osxsave or maxleaf < 7) return isa::ssse3;
+
+    /* the OS must save the ymm (and zmm) registers on context switches */
+    const auto xcr0 = _xgetbv(0);
+    if ((xcr0 & 0x06) != 0x06) return isa::ssse3;
+
+    __cpuidex(regs, 7, 0);
+    const bool avx2     = regs[1] & (1 << 5);
+    const bool avx512f  = regs[1] & (1 << 16);
+    const bool avx512bw = regs[1] & (1 << 30);
+    if (!avx2) return isa::ssse3;
+    if ((xcr0 & 0xE0) != 0xE0) return isa::avx2;
+    if (avx512f and avx512bw) return isa::avx512;
+    return isa::avx2;
+#else
+    /*
+     * The kernels are selected by a static initializer, which may run before
+     * libgcc's own constructor has populated the cpu model
+     */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512bw"))
+        return isa::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return isa::avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return isa::ssse3;
+    return isa::scalar;
+#endif
+}
+
+#endif
+
+decode_kernels select_kernels() noexcept (true) {
+    decode_kernels k;
+    k.swap32    = memcpy_bswap32_scalar;
+    k.swap64    = memcpy_bswap64_scalar;
+    k.pack_logi = pack_logi_scalar;
+    k.popcount  = popcount_scalar;
+    k.swapped   = scalar_converters< true >();
+    k.unswapped = scalar_converters< false >();
+
+#if defined(ECL3_X86_KERNELS)
+    const auto level = cpu_isa();
+    if (level == isa::ssse3) {
+        k.swap32    = memcpy_bswap32_ssse3;
+        k.swap64    = memcpy_bswap64_ssse3;
+        k.pack_logi = pack_logi_sse2;
+    }
+
+    if (level == isa::avx2 or level == isa::avx512) {
+        k.swap32    = memcpy_bswap32_avx2;
+        k.swap64    = memcpy_bswap64_avx2;
+        k.pack_logi = pack_logi_avx2;
+        /* every cpu with avx2 also has popcnt */
+        k.popcount  = popcount_popcnt;
+        k.swapped   = avx2_converters< true >();
+        k.unswapped = avx2_converters< false >();
+    }
+
+    if (level == isa::avx512) {
+        k.swap32 = memcpy_bswap32_avx512;
+        k.swap64 = memcpy_bswap64_avx512;
+    }
+#elif defined(ECL3_NEON_KERNELS)
+    /* NEON is mandatory whenever it is available at compile time */
+    k.swap32 = memcpy_bswap32_neon;
+    k.swap64 = memcpy_bswap64_neon;
+#endif
+
+    return k;
+}
+
+/*
+ * Resolved once, on first use. A function-local static is initialised
+ * thread-safely, and unlike a namespace-scope one, it is valid when called
+ * from other static initializers too.
+ */
+const decode_kernels& kernels() noexcept (true) {
+    static const decode_kernels k = select_kernels();
+    return k;
+}
+
+void memcpy_bswap32(void* dst, const void* src, std::size_t nmemb)
+noexcept (true) {
+    kernels().swap32(dst, src, nmemb);
+}
+
+void memcpy_bswap64(void* dst, const void* src, std::size_t nmemb)
+noexcept (true) {
+    kernels().swap64(dst, src, nmemb);
+}
+
+#if defined(ENDIANNESS_BIG_ENDIAN)
+constexpr int host_byteorder = ECL3_BIG_ENDIAN;
+#elif defined(ENDIANNESS_LITTLE_ENDIAN)
+constexpr int host_byteorder = ECL3_LITTLE_ENDIAN;
 #else
     #error "ENDIANNESS_BIG_ENDIAN or ENDIANNESS_LITTLE_ENDIAN must be set"
 #endif
 
+bool valid_byteorder(int order) noexcept (true) {
+    return order == ECL3_BIG_ENDIAN or order == ECL3_LITTLE_ENDIAN;
+}
+
+/*
+ * When the file is already in host byte order there is nothing to decode, and
+ * in-place reads are no-ops
+ */
+void memcpy_ordered32(void* dst,
+                      const void* src,
+                      std::size_t nmemb,
+                      bool swap) noexcept (true) {
+    if (swap) return memcpy_bswap32(dst, src, nmemb);
+    if (dst == src) return;
+    std::memmove(dst, src, nmemb * sizeof(std::uint32_t));
+}
+
+void memcpy_ordered64(void* dst,
+                      const void* src,
+                      std::size_t nmemb,
+                      bool swap) noexcept (true) {
+    if (swap) return memcpy_bswap64(dst, src, nmemb);
+    if (dst == src) return;
+    std::memmove(dst, src, nmemb * sizeof(std::uint64_t));
+}
+
 }
 
 int ecl3_get_native(void* dst, const void* src, int fmt, std::size_t elems) {
+    return ecl3_get_native_from(dst, src, fmt, elems, ECL3_BIG_ENDIAN);
+}
+
+int ecl3_get_native_from(void* dst,
+                         const void* src,
+                         int fmt,
+                         std::size_t elems,
+                         int order) {
+    if (not valid_byteorder(order))
+        return ECL3_INVALID_ARGS;
+
+    const auto swap = order != host_byteorder;
     switch (fmt) {
         case ECL3_INTE:
         case ECL3_REAL:
         case ECL3_LOGI:
-            memcpy_msb32(dst, src, elems);
+            memcpy_ordered32(dst, src, elems, swap);
             return ECL3_OK;
 
         case ECL3_DOUB:
-            memcpy_msb64(dst, src, elems);
+            memcpy_ordered64(dst, src, elems, swap);
             return ECL3_OK;
 
         case ECL3_MESS:
@@ -90,14 +724,190 @@ int ecl3_get_native(void* dst, const void* src, int fmt, std::size_t elems) {
     return ECL3_OK;
 }
 
+int ecl3_get_native_as(void* dst,
+                       const void* src,
+                       int fmt,
+                       int native,
+                       std::size_t elems) {
+    return ecl3_get_native_as_from(
+        dst,
+        src,
+        fmt,
+        native,
+        elems,
+        ECL3_BIG_ENDIAN
+    );
+}
+
+int ecl3_get_native_as_from(void* dst,
+                            const void* src,
+                            int fmt,
+                            int native,
+                            std::size_t elems,
+                            int order) {
+    if (not valid_byteorder(order))
+        return ECL3_INVALID_ARGS;
+
+    const auto& all = kernels();
+    const auto& k = order == host_byteorder ? all.unswapped : all.swapped;
+    kernel convert = nullptr;
+
+    switch (fmt) {
+        case ECL3_INTE:
+            switch (native) {
+                case ECL3_NATIVE_INT32:
+                    return ecl3_get_native_from(dst, src, fmt, elems, order);
+                case ECL3_NATIVE_INT64:  convert = k.inte_int64;  break;
+                case ECL3_NATIVE_FLOAT:  convert = k.inte_float;  break;
+                case ECL3_NATIVE_DOUBLE: convert = k.inte_double; break;
+                default:
+                    return ECL3_INVALID_ARGS;
+            }
+            break;
+
+        case ECL3_REAL:
+            switch (native) {
+                case ECL3_NATIVE_FLOAT:
+                    return ecl3_get_native_from(dst, src, fmt, elems, order);
+                case ECL3_NATIVE_DOUBLE: convert = k.real_double; break;
+                case ECL3_NATIVE_INT32:
+                case ECL3_NATIVE_INT64:
+                    return ECL3_UNSUPPORTED;
+                default:
+                    return ECL3_INVALID_ARGS;
+            }
+            break;
+
+        case ECL3_DOUB:
+            switch (native) {
+                case ECL3_NATIVE_DOUBLE:
+                    return ecl3_get_native_from(dst, src, fmt, elems, order);
+                case ECL3_NATIVE_FLOAT:  convert = k.doub_float; break;
+                case ECL3_NATIVE_INT32:
+                case ECL3_NATIVE_INT64:
+                    return ECL3_UNSUPPORTED;
+                default:
+                    return ECL3_INVALID_ARGS;
+            }
+            break;
+
+        default: {
+            /* distinguish between unknown and non-numeric types */
+            int size;
+            const auto err = ecl3_type_size(fmt, &size);
+            return err ? err : ECL3_UNSUPPORTED;
+        }
+    }
+
+    convert(dst, src, elems);
+    return ECL3_OK;
+}
+
 int ecl3_put_native(void* dst, const void* src, int fmt, std::size_t elems) {
     /*
-     * get/put native are currently the same, because there is no little-endian
-     * input support. They both exist for symmetry.
+     * get/put native are the same, because byte swapping is its own inverse,
+     * and output is always big-endian. They both exist for symmetry.
      */
     return ecl3_get_native(dst, src, fmt, elems);
 }
 
+int ecl3_pack_logi(std::uint64_t* dst, const void* src, std::size_t elems) {
+    kernels().pack_logi(dst, src, elems);
+    return ECL3_OK;
+}
+
+std::uint64_t ecl3_popcount(const std::uint64_t* bits, std::size_t nbits) {
+    const auto words = nbits / 64;
+    const auto rest = nbits % 64;
+    auto count = kernels().popcount(bits, words);
+    if (rest > 0) {
+        const auto mask = (std::uint64_t(1) << rest) - 1;
+        count += popcount64(bits[words] & mask);
+    }
+    return count;
+}
+
+std::uint64_t ecl3_rank(const std::uint64_t* bits, std::size_t pos) {
+    return ecl3_popcount(bits, pos);
+}
+
+int ecl3_native_byteorder() {
+    return host_byteorder;
+}
+
+int ecl3_detect_byteorder(const void* source, int* order) {
+    const auto* src = reinterpret_cast< const char* >(source);
+
+    /*
+     * The first record in a file is always an array header, which is 16 bytes
+     * long. The value 16 can only be read in one byte order, but to be less
+     * susceptible to garbage input, also check that the tail matches, and that
+     * the header's type is an actual type.
+     */
+    std::uint32_t head;
+    std::memcpy(&head, src, sizeof(head));
+    if (std::memcmp(src, src + 20, sizeof(head)) != 0)
+        return ECL3_INVALID_ARGS;
+
+    int type;
+    if (ecl3_typeid(src + 16, &type) != ECL3_OK)
+        return ECL3_INVALID_ARGS;
+
+    const auto header_size = std::uint32_t(ecl3_array_header_size());
+    if (be32toh(head) == header_size) {
+        *order = ECL3_BIG_ENDIAN;
+        return ECL3_OK;
+    }
+
+    if (le32toh(head) == header_size) {
+        *order = ECL3_LITTLE_ENDIAN;
+        return ECL3_OK;
+    }
+
+    return ECL3_INVALID_ARGS;
+}
+
+int ecl3_detect_record_marker(const void* source, int* order, int* size) {
+    const auto* src = reinterpret_cast< const char* >(source);
+    const auto header_size = std::uint32_t(ecl3_array_header_size());
+
+    std::uint32_t narrow;
+    std::uint64_t wide;
+    std::memcpy(&narrow, src, sizeof(narrow));
+    std::memcpy(&wide, src, sizeof(wide));
+
+    if (be32toh(narrow) == header_size) {
+        *order = ECL3_BIG_ENDIAN;
+        *size = sizeof(narrow);
+        return ECL3_OK;
+    }
+
+    if (be64toh(wide) == header_size) {
+        *order = ECL3_BIG_ENDIAN;
+        *size = sizeof(wide);
+        return ECL3_OK;
+    }
+
+    /*
+     * A little-endian 8-byte marker is also a valid 4-byte marker, so check
+     * for the wide marker first. It is only a 4-byte marker if the keyword,
+     * which is never NUL, follows.
+     */
+    if (le64toh(wide) == header_size) {
+        *order = ECL3_LITTLE_ENDIAN;
+        *size = sizeof(wide);
+        return ECL3_OK;
+    }
+
+    if (le32toh(narrow) == header_size) {
+        *order = ECL3_LITTLE_ENDIAN;
+        *size = sizeof(narrow);
+        return ECL3_OK;
+    }
+
+    return ECL3_INVALID_ARGS;
+}
+
 int ecl3_array_header_size() {
     /*
      * Described in the manual to be 16 bytes long
@@ -106,16 +916,36 @@ int ecl3_array_header_size() {
 }
 
 int ecl3_array_header(const void* source, char* kw, char* type, int* count) {
+    return ecl3_array_header_from(source, kw, type, count, ECL3_BIG_ENDIAN);
+}
+
+int ecl3_array_header_from(const void* source,
+                           char* kw,
+                           char* type,
+                           int* count,
+                           int order) {
     const auto* src = reinterpret_cast< const char* >(source);
 
+    std::int32_t tmp;
+    const auto err = ecl3_get_native_from(&tmp, src + 8, ECL3_INTE, 1, order);
+    if (err) return err;
+
     std::memcpy(kw, src, 8);
-    std::uint32_t tmp;
-    ecl3_get_native(&tmp, src + 8, ECL3_INTE, 1);
     std::memcpy(type, src + 12, 4);
     *count = tmp;
     return ECL3_OK;
 }
 
+std::uint64_t ecl3_keyword_token(const char* kw) {
+    std::uint64_t token = 0;
+    std::size_t i = 0;
+    for (; i < 8 and kw[i] != '\0'; ++i)
+        token |= std::uint64_t(static_cast< unsigned char >(kw[i])) << (8 * i);
+    for (; i < 8; ++i)
+        token |= std::uint64_t(' ') << (8 * i);
+    return token;
+}
+
 namespace {
 
 constexpr bool isC0NN(int type) noexcept (true) {
@@ -154,9 +984,27 @@ int ecl3_block_size(int type, int* size) {
 int ecl3_array_body(void* dst,
                     const void* src,
                     int type,
-                    int elems,
+                    std::int64_t elems,
                     int block_size,
                     int* count) {
+    return ecl3_array_body_from(
+        dst,
+        src,
+        type,
+        elems,
+        block_size,
+        count,
+        ECL3_BIG_ENDIAN
+    );
+}
+
+int ecl3_array_body_from(void* dst,
+                         const void* src,
+                         int type,
+                         std::int64_t elems,
+                         int block_size,
+                         int* count,
+                         int order) {
 
     switch (type) {
         case ECL3_MESS:
@@ -167,8 +1015,212 @@ int ecl3_array_body(void* dst,
             break;
     }
 
-    elems = std::min(elems, block_size);
-    ecl3_get_native(dst, src, type, elems);
+    const auto n = int(std::min(elems, std::int64_t(block_size)));
+    const auto err = ecl3_get_native_from(dst, src, type, n, order);
+    if (err) return err;
+
+    *count = n;
+    return ECL3_OK;
+}
+
+namespace {
+
+/*
+ * Read a record marker, widened to 64 bits. Lengths that do not fit in a
+ * signed 32-bit marker are negative (continuation records), which never
+ * match an expected length.
+ */
+std::int64_t record_marker(const char* src, int marker, bool swap)
+noexcept (true) {
+    if (marker == 4) {
+        std::int32_t x;
+        std::memcpy(&x, src, sizeof(x));
+        if (swap) x = std::int32_t(bswap32(std::uint32_t(x)));
+        return x;
+    }
+
+    std::int64_t x;
+    std::memcpy(&x, src, sizeof(x));
+    if (swap) x = std::int64_t(bswap64(std::uint64_t(x)));
+    return x;
+}
+
+/*
+ * Check that the record at src has the expected length and a matching tail,
+ * without reading past end
+ */
+bool valid_record(const char* src,
+                  const char* end,
+                  int marker,
+                  bool swap,
+                  std::int64_t expected) noexcept (true) {
+    if (record_marker(src, marker, swap) != expected)
+        return false;
+
+    const auto* tail = src + marker + expected;
+    return tail + marker <= end
+       and std::memcmp(src, tail, std::size_t(marker)) == 0;
+}
+
+}
+
+int ecl3_scan_arrays(const void* source,
+                     std::size_t size,
+                     int order,
+                     int marker,
+                     ecl3_array_entry* entries,
+                     std::size_t capacity,
+                     std::size_t* count,
+                     std::size_t* consumed) {
+    *count = 0;
+    *consumed = 0;
+
+    if (not valid_byteorder(order)) return ECL3_INVALID_ARGS;
+    if (marker != 4 and marker != 8) return ECL3_INVALID_ARGS;
+
+    const auto* begin = reinterpret_cast< const char* >(source);
+    const auto* end = begin + size;
+    const bool swap = order != host_byteorder;
+    const auto header_size = ecl3_array_header_size();
+    const auto header_record = 2 * marker + header_size;
+
+    const auto* pos = begin;
+    while (*count < capacity) {
+        if (end - pos < header_record) break;
+
+        if (not valid_record(pos, end, marker, swap, header_size))
+            return ECL3_INVALID_ARGS;
+
+        auto& entry = entries[*count];
+        int elems;
+        ecl3_array_header_from(pos + marker,
+                               entry.keyword,
+                               entry.type,
+                               &elems,
+                               order);
+        /* a whole keyword is the token, as loaded little-endian */
+        std::uint64_t token;
+        std::memcpy(&token, entry.keyword, sizeof(token));
+        entry.token = host_byteorder == ECL3_LITTLE_ENDIAN
+                    ? token
+                    : bswap64(token)
+                    ;
+
+        int type;
+        int elemsize;
+        int blocksize;
+        const auto err = ecl3_typeid(entry.type, &type)
+                      or ecl3_type_size(type, &elemsize)
+                      or ecl3_block_size(type, &blocksize)
+                      ;
+        if (err or elems < 0) return ECL3_INVALID_ARGS;
+
+        /*
+         * Walk the body blocks, but stop without an error if the buffer ends
+         * inside the body, since the array can be scanned in the next window
+         */
+        const auto* body = pos + header_record;
+        const auto* src = body;
+        bool truncated = false;
+        for (std::int64_t left = elems; left > 0; left -= blocksize) {
+            const auto len = std::min(left, std::int64_t(blocksize)) * elemsize;
+            if (end - src < 2 * marker + len) {
+                truncated = true;
+                break;
+            }
+
+            if (not valid_record(src, end, marker, swap, len))
+                return ECL3_INVALID_ARGS;
+
+            src += 2 * marker + len;
+        }
+        if (truncated) break;
+
+        entry.count = elems;
+        entry.header_offset = pos - begin;
+        entry.body_offset = body - begin;
+        entry.body_size = src - body;
+
+        pos = src;
+        ++*count;
+        *consumed = std::size_t(pos - begin);
+    }
+
+    return ECL3_OK;
+}
+
+int ecl3_array_body_ranges(void* dst,
+                           const ecl3_body_range* ranges,
+                           std::size_t nranges,
+                           int type,
+                           std::int64_t elems,
+                           int marker,
+                           int order,
+                           std::int64_t* count) {
+    *count = 0;
+
+    switch (type) {
+        case ECL3_MESS:
+        case ECL3_X231:
+            return ECL3_UNSUPPORTED;
+
+        default:
+            break;
+    }
+
+    int elemsize;
+    int blocksize;
+    const auto err = ecl3_type_size(type, &elemsize)
+                  or ecl3_block_size(type, &blocksize)
+                  ;
+    if (err) return err;
+    if (not valid_byteorder(order)) return ECL3_INVALID_ARGS;
+    if (marker != 4 and marker != 8) return ECL3_INVALID_ARGS;
+    if (elems < 0) return ECL3_INVALID_ARGS;
+
+    const bool swap = order != host_byteorder;
+
+    /*
+     * Check all the records first, which only touches the markers, so that
+     * the decoding pass can stream through the blocks without branching on
+     * broken input, and dst is never half-written
+     */
+    auto left = elems;
+    for (std::size_t i = 0; i < nranges; ++i) {
+        const auto* src = reinterpret_cast< const char* >(ranges[i].data);
+        const auto* end = src + ranges[i].size;
+        while (src != end) {
+            if (left == 0) return ECL3_INVALID_ARGS;
+
+            const auto n = std::min(left, std::int64_t(blocksize));
+            const auto len = n * elemsize;
+            if (end - src < 2 * marker + len)
+                return ECL3_INVALID_ARGS;
+            if (not valid_record(src, end, marker, swap, len))
+                return ECL3_INVALID_ARGS;
+
+            src += 2 * marker + len;
+            left -= n;
+        }
+    }
+    if (left != 0) return ECL3_INVALID_ARGS;
+
+    auto* out = reinterpret_cast< char* >(dst);
+    left = elems;
+    for (std::size_t i = 0; i < nranges; ++i) {
+        const auto* src = reinterpret_cast< const char* >(ranges[i].data);
+        const auto* end = src + ranges[i].size;
+        while (src != end) {
+            const auto n = std::min(left, std::int64_t(blocksize));
+            const auto len = n * elemsize;
+            const auto* block = src + marker;
+            ecl3_get_native_from(out, block, type, std::size_t(n), order);
+            src += 2 * marker + len;
+            out += len;
+            left -= n;
+        }
+    }
+
     *count = elems;
     return ECL3_OK;
 }
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <ciso646>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <ecl3/compressed.hpp>
+#include <ecl3/io.hpp>
+#include <ecl3/keyword.h>
+#include <ecl3/smspec.hpp>
+#include <ecl3/summary.h>
+#include <ecl3/typed.hpp>
+
+namespace ecl3 {
+
+namespace {
+
+std::string strip(const char* begin, const char* end) {
+    while (begin != end and *begin == ' ') ++begin;
+    while (end != begin and *(end - 1) == ' ') --end;
+    return std::string(begin, end);
+}
+
+/*
+ * The string elements of a CHAR or C0NN array. The element width is only
+ * known at runtime for C0NN, so this does not go through typed_array.
+ */
+int string_width(const raw_array& x) {
+    int type;
+    int size;
+    const auto err = ecl3_typeid(x.type.data(), &type)
+                  or ecl3_type_size(type, &size)
+                  ;
+
+    const bool string = not err
+                    and (type == ECL3_CHAR or is_c0nn_type(type))
+                    ;
+    if (not string) {
+        std::stringstream ss;
+        ss << "expected " << x.token.str() << " to be CHAR or C0NN, was "
+           << "'" << std::string(x.type.data(), x.type.size()) << "'"
+        ;
+        throw invalid_type(ss.str());
+    }
+
+    return size;
+}
+
+std::vector< std::string > strings(const raw_array& x) {
+    const auto width = std::size_t(string_width(x));
+    const auto* src = reinterpret_cast< const char* >(x.body.data());
+
+    std::vector< std::string > xs;
+    xs.reserve(std::size_t(x.count));
+    for (std::int64_t i = 0; i < x.count; ++i, src += width)
+        xs.push_back(strip(src, src + width));
+    return xs;
+}
+
+/* All the strings of x, concatenated and stripped, like RESTART */
+std::string joined(const raw_array& x) {
+    const auto width = std::size_t(string_width(x));
+    const auto* src = reinterpret_cast< const char* >(x.body.data());
+    return strip(src, src + width * std::size_t(x.count));
+}
+
+template < typename T >
+std::vector< T > values(const raw_array& x) {
+    const typed_array< T > xs(x);
+    return std::vector< T >(xs.begin(), xs.end());
+}
+
+constexpr keyword_token INTEHEAD = "INTEHEAD";
+constexpr keyword_token RESTART  = "RESTART";
+constexpr keyword_token DIMENS   = "DIMENS";
+constexpr keyword_token KEYWORDS = "KEYWORDS";
+constexpr keyword_token WGNAMES  = "WGNAMES";
+constexpr keyword_token NAMES    = "NAMES";
+constexpr keyword_token NUMS     = "NUMS";
+constexpr keyword_token LGRS     = "LGRS";
+constexpr keyword_token NUMLX    = "NUMLX";
+constexpr keyword_token NUMLY    = "NUMLY";
+constexpr keyword_token NUMLZ    = "NUMLZ";
+constexpr keyword_token LENGTHS  = "LENGTHS";
+constexpr keyword_token LENUNITS = "LENUNITS";
+constexpr keyword_token MEASRMNT = "MEASRMNT";
+constexpr keyword_token UNITS    = "UNITS";
+constexpr keyword_token STARTDAT = "STARTDAT";
+constexpr keyword_token LGRNAMES = "LGRNAMES";
+constexpr keyword_token LGRVEC   = "LGRVEC";
+constexpr keyword_token LGRTIMES = "LGRTIMES";
+constexpr keyword_token RUNTIMEI = "RUNTIMEI";
+constexpr keyword_token RUNTIMED = "RUNTIMED";
+constexpr keyword_token STEPRESN = "STEPRESN";
+constexpr keyword_token XCOORD   = "XCOORD";
+constexpr keyword_token YCOORD   = "YCOORD";
+constexpr keyword_token TIMESTMP = "TIMESTMP";
+
+}
+
+bool smspec::has(keyword_token kw) const noexcept (true) {
+    const auto end = this->present.end();
+    return std::find(this->present.begin(), end, kw) != end;
+}
+
+void smspec::update(const raw_array& x) {
+    const auto kw = x.token;
+
+    if (kw == DIMENS) {
+        const auto dimens = values< std::int32_t >(x);
+        if (dimens.size() < 6)
+            throw std::invalid_argument("expected DIMENS to have 6 values");
+        this->nlist = dimens[0];
+        this->nx    = dimens[1];
+        this->ny    = dimens[2];
+        this->nz    = dimens[3];
+        this->istar = dimens[5];
+        this->dimens = dimens;
+    }
+    else if (kw == KEYWORDS) this->keywords = strings(x);
+    else if (kw == WGNAMES)  this->wgnames  = strings(x);
+    else if (kw == NAMES)    this->names    = strings(x);
+    else if (kw == NUMS)     this->nums     = values< std::int32_t >(x);
+    else if (kw == UNITS)    this->units    = strings(x);
+    else if (kw == LGRS)     this->lgrs     = strings(x);
+    else if (kw == NUMLX)    this->numlx    = values< std::int32_t >(x);
+    else if (kw == NUMLY)    this->numly    = values< std::int32_t >(x);
+    else if (kw == NUMLZ)    this->numlz    = values< std::int32_t >(x);
+    else if (kw == LENGTHS)  this->lengths  = values< float >(x);
+    else if (kw == XCOORD)   this->xcoord   = values< float >(x);
+    else if (kw == YCOORD)   this->ycoord   = values< float >(x);
+    else if (kw == RESTART)  this->restart  = joined(x);
+    else if (kw == STEPRESN) this->step_reason = joined(x);
+    else if (kw == LGRNAMES) this->lgrnames = strings(x);
+    else if (kw == LGRVEC)   this->lgrvec   = values< std::int32_t >(x);
+    else if (kw == LGRTIMES) this->lgrtimes = values< std::int32_t >(x);
+    else if (kw == INTEHEAD) this->intehead = values< std::int32_t >(x);
+    else if (kw == STARTDAT) this->startdat = values< std::int32_t >(x);
+    else if (kw == RUNTIMEI) this->runtimei = values< std::int32_t >(x);
+    else if (kw == RUNTIMED) this->runtimed = values< double >(x);
+    else if (kw == TIMESTMP) this->timestamp = values< std::int32_t >(x);
+    else if (kw == LENUNITS) {
+        /* kept as on disk, padding included */
+        const auto width = std::size_t(string_width(x));
+        const auto* src = reinterpret_cast< const char* >(x.body.data());
+        this->lenunits = x.count > 0 ? std::string(src, width) : "";
+    }
+    else if (kw == MEASRMNT) {
+        /*
+         * The measurements are split into blocks of strings per vector, so
+         * join them back together
+         */
+        if (this->nlist <= 0)
+            throw std::invalid_argument("MEASRMNT before DIMENS");
+        if (x.count % this->nlist != 0) {
+            const auto msg = "measurement blocks does not evenly divide NLIST";
+            throw std::invalid_argument(msg);
+        }
+
+        const auto width = std::size_t(string_width(x));
+        const auto block = width * std::size_t(x.count / this->nlist);
+        const auto* src = reinterpret_cast< const char* >(x.body.data());
+        this->measurements.clear();
+        this->measurements.reserve(std::size_t(this->nlist));
+        for (std::int32_t i = 0; i < this->nlist; ++i, src += block)
+            this->measurements.push_back(strip(src, src + block));
+    }
+    else {
+        this->unhandled.push_back(x);
+    }
+
+    this->present.push_back(kw);
+}
+
+namespace {
+
+/*
+ * Only the known void markers are void. Blank names are stripped to "", and
+ * are not void, so a blank well name gives a column like WWCT.
+ */
+bool is_void(const std::string& x) noexcept (true) {
+    return x == ":+:+:+:+" or x == "        ";
+}
+
+bool is_void(std::int32_t x) noexcept (true) {
+    return x < 0;
+}
+
+/* append the decimal digits of x, which must be non-negative */
+void append(std::string& dst, std::int32_t x) {
+    char buf[16];
+    auto* end = buf + sizeof(buf);
+    auto* p = end;
+    do {
+        *--p = char('0' + x % 10);
+        x /= 10;
+    } while (x > 0);
+    dst.append(p, end);
+}
+
+/*
+ * The hash set stores column indices, and hashes and compares the names they
+ * point to in the column storage. This way the set holds no strings of its
+ * own, and growing the storage does not invalidate the set.
+ */
+struct name_hash {
+    const columns* cols;
+
+    std::size_t operator()(std::size_t i) const noexcept (true) {
+        /* FNV-1a */
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        const auto begin = this->cols->offsets[i];
+        const auto end = this->cols->offsets[i + 1];
+        for (auto k = begin; k < end; ++k) {
+            h ^= static_cast< unsigned char >(this->cols->chars[k]);
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
+};
+
+struct name_equal {
+    const columns* cols;
+
+    bool operator()(std::size_t i, std::size_t j) const noexcept (true) {
+        const auto& off = this->cols->offsets;
+        const auto len = off[i + 1] - off[i];
+        if (len != off[j + 1] - off[j]) return false;
+
+        const auto* chars = this->cols->chars.data();
+        return std::memcmp(chars + off[i], chars + off[j], len) == 0;
+    }
+};
+
+void check_length(const char* name, std::size_t size, std::size_t n) {
+    if (size == n) return;
+
+    std::stringstream ss;
+    ss << "expected " << name << " to have " << n << " elements, "
+       << "was " << size
+    ;
+    throw std::invalid_argument(ss.str());
+}
+
+}
+
+std::size_t columns::size() const noexcept (true) {
+    return this->pos.size();
+}
+
+std::string columns::name(std::size_t i) const {
+    const auto begin = this->offsets.at(i);
+    return this->chars.substr(begin, this->offsets.at(i + 1) - begin);
+}
+
+columns resolve_columns(const std::vector< std::string >& keywords,
+                        const std::vector< std::string >& wgnames,
+                        const std::vector< std::int32_t >& nums,
+                        const std::vector< std::string >& lgrs,
+                        const std::vector< std::int32_t >& numlx,
+                        const std::vector< std::int32_t >& numly,
+                        const std::vector< std::int32_t >& numlz,
+                        const std::string& separator) {
+    const auto n = keywords.size();
+    check_length("WGNAMES", wgnames.size(), n);
+    check_length("NUMS", nums.size(), n);
+    if (not lgrs.empty())  check_length("LGRS",  lgrs.size(),  n);
+    if (not numlx.empty()) check_length("NUMLX", numlx.size(), n);
+    if (not numly.empty()) check_length("NUMLY", numly.size(), n);
+    if (not numlz.empty()) check_length("NUMLZ", numlz.size(), n);
+
+    columns cols;
+    /* most names are a keyword and a well, i.e. less than 24 characters */
+    cols.chars.reserve(n * 24);
+    cols.offsets.reserve(n + 1);
+    cols.offsets.push_back(0);
+    cols.pos.reserve(n);
+
+    std::unordered_set< std::size_t, name_hash, name_equal > seen(
+        n,
+        name_hash { &cols },
+        name_equal { &cols }
+    );
+
+    /* classify all vectors up front, from the keywords as on disk */
+    std::vector< char > padded(n * 8, ' ');
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto& keyword = keywords[i];
+        const auto len = std::min(keyword.size(), std::size_t(8));
+        std::memcpy(padded.data() + 8 * i, keyword.data(), len);
+    }
+    std::vector< std::uint8_t > masks(n);
+    ecl3_params_classify(padded.data(), n, masks.data(), nullptr);
+
+    auto& out = cols.chars;
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto& keyword = keywords[i];
+        const auto mask = masks[i];
+        const auto identifies = [mask](int id) {
+            return (mask & id) != 0;
+        };
+
+        const auto start = out.size();
+        out += keyword;
+
+        if (identifies(ECL3_PARAMS_WGNAMES)) {
+            if (is_void(wgnames[i])) { out.resize(start); continue; }
+            out += separator;
+            out += wgnames[i];
+        }
+
+        if (identifies(ECL3_PARAMS_NUMS)) {
+            if (is_void(nums[i])) { out.resize(start); continue; }
+            out += separator;
+            append(out, nums[i]);
+        }
+
+        if (not lgrs.empty() and identifies(ECL3_PARAMS_LGRS)) {
+            if (is_void(lgrs[i])) { out.resize(start); continue; }
+            out += separator;
+            out += lgrs[i];
+        }
+
+        const std::vector< std::int32_t >* numl[] = { &numlx, &numly, &numlz };
+        const int numl_ids[] = {
+            ECL3_PARAMS_NUMLX,
+            ECL3_PARAMS_NUMLY,
+            ECL3_PARAMS_NUMLZ,
+        };
+        bool void_numl = false;
+        for (int k = 0; k < 3; ++k) {
+            const auto& xs = *numl[k];
+            if (xs.empty() or not identifies(numl_ids[k])) continue;
+            void_numl = is_void(xs[i]);
+            if (void_numl) break;
+            out += separator;
+            append(out, xs[i]);
+        }
+        if (void_numl) { out.resize(start); continue; }
+
+        cols.offsets.push_back(out.size());
+        const auto inserted = seen.insert(cols.offsets.size() - 2).second;
+        if (not inserted) {
+            /* a duplicate somehow - keep the first */
+            cols.offsets.pop_back();
+            out.resize(start);
+            continue;
+        }
+
+        cols.pos.push_back(std::int32_t(i));
+    }
+
+    return cols;
+}
+
+smspec read_smspec(const std::string& path) {
+    stream_reader< compressed_stream > fs(path);
+    return read_smspec(fs);
+}
+
+smspec read_smspec(const void* data, std::size_t size) {
+    stream_reader< buffer_stream > fs(data, size);
+    return read_smspec(fs);
+}
+
+}
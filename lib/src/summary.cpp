@@ -1,6 +1,7 @@
 #include <ciso646>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <string>
 
 #include <ecl3/summary.h>
 
@@ -74,112 +75,145 @@ const char** ecl3_params_partial_identifiers(void) {
     return kws;
 }
 
-int ecl3_params_identifies(const char* type, const char* keyword) {
-    static constexpr const auto WGNAMES = "WGNAMES ";
-    static constexpr const auto NUMS    = "NUMS    ";
-    static constexpr const auto LGRS    = "LGRS    ";
-    static constexpr const auto NUMLX   = "NUMLX   ";
-    static constexpr const auto NUMLY   = "NUMLY   ";
-    static constexpr const auto NUMLZ   = "NUMLZ   ";
-
-    const auto id = std::string(type, 8);
-
-    switch (keyword[0]) {
+namespace {
+
+constexpr std::uint8_t WGNAMES = ECL3_PARAMS_WGNAMES;
+constexpr std::uint8_t NUMS    = ECL3_PARAMS_NUMS;
+constexpr std::uint8_t LGRS    = ECL3_PARAMS_LGRS;
+constexpr std::uint8_t NUMLX   = ECL3_PARAMS_NUMLX;
+constexpr std::uint8_t NUMLY   = ECL3_PARAMS_NUMLY;
+constexpr std::uint8_t NUMLZ   = ECL3_PARAMS_NUMLZ;
+constexpr std::uint8_t NUML    = NUMLX | NUMLY | NUMLZ;
+
+struct rule {
+    std::uint8_t mask;
+    std::uint8_t count;
+    /* the keyword needs a closer look than its first character */
+    bool special;
+};
+
+/*
+ * The rules, indexed by the first character of the keyword. Most keywords
+ * are fully classified by this lookup, and the ones marked special are
+ * refined in classify().
+ */
+struct rule_table {
+    rule rules[256];
+
+    rule_table() noexcept (true) : rules() {
         /* Aquifer data */
-        case 'A':
-            return id == NUMS ? 1 : 0;
-
+        this->rules['A'] = rule { NUMS, 1, false };
         /* Block data */
-        case 'B':
-            return id == NUMS ? 1 : 0;
-
+        this->rules['B'] = rule { NUMS, 1, false };
         /* Completion or connection data */
-        case 'C':
-            return (id == WGNAMES or id == NUMS) ? 2 : 0;
-
+        this->rules['C'] = rule { WGNAMES | NUMS, 2, false };
         /* Group data */
-        case 'G':
-            if (keyword[1] == 'M') return 0;
-            return id == WGNAMES ? 1 : 0;
-
+        this->rules['G'] = rule { WGNAMES, 1, true };
         /* Well data */
-        case 'W':
-            /* 
+        this->rules['W'] = rule { WGNAMES, 1, true };
+        this->rules['P'] = rule { WGNAMES, 1, false };
+        this->rules['R'] = rule { NUMS, 1, false };
+        /* Local grid data */
+        this->rules['L'] = rule { 0, 0, true };
+        /* Network data */
+        this->rules['N'] = rule { WGNAMES, 1, true };
+        /* Segment data */
+        this->rules['S'] = rule { WGNAMES | NUMS, 2, true };
+    }
+};
+
+/*
+ * A function-local static, so that the table is built on first use, and is
+ * valid even when called from other static initializers
+ */
+const rule_table& rules() noexcept (true) {
+    static const rule_table table;
+    return table;
+}
+
+bool is(const char* keyword, const char* other) noexcept (true) {
+    return std::memcmp(keyword, other, 8) == 0;
+}
+
+rule classify(const rule_table& table, const char* keyword) noexcept (true) {
+    const auto r = table.rules[static_cast< unsigned char >(keyword[0])];
+    if (not r.special) return r;
+
+    constexpr rule none = { 0, 0, false };
+
+    switch (keyword[0]) {
+        case 'G':
+            /*
              * The {F,G,W}M mnemonics are reserved for other uses than
              * well/group, and are not parametrised
              */
-            if (keyword[1] == 'M') return 0;
+            if (keyword[1] == 'M') return none;
+            return r;
 
+        case 'W':
+            if (keyword[1] == 'M') return none;
             // of course, WNEWTON is also a thing
-            if (std::strncmp(keyword, "WNEWTON ", 8) == 0) return 0;
-
-            return id == WGNAMES ? 1 : 0;
-
-        case 'P':
-            return id == WGNAMES ? 1 : 0;
-
-        case 'R':
-            return id == NUMS ? 1 : 0;
+            if (is(keyword, "WNEWTON ")) return none;
+            return r;
 
         case 'L':
+            switch (keyword[1]) {
+                case 'B': return rule { LGRS | NUML, 4, false };
+                case 'C': return rule { LGRS | WGNAMES | NUML, 4, false };
+                case 'W': return rule { LGRS | WGNAMES, 2, false };
+                default:  return none;
+            }
+
         case 'N':
+            if (is(keyword, "NEWTON  ")) return none;
+            if (is(keyword, "NAIMFRAC")) return none;
+            if (is(keyword, "NLINEARS")) return none;
+            if (is(keyword, "NLINSMIN")) return none;
+            if (is(keyword, "NLINSMAX")) return none;
+            return r;
+
         case 'S':
-            /* require more information - handle outside the switch */
-            break;
+            if (is(keyword, "STEPTYPE")) return none;
+            if (std::memcmp(keyword, "SGAS", 4) == 0) return none;
+            if (std::memcmp(keyword, "SOIL", 4) == 0) return none;
+            if (std::memcmp(keyword, "SWAT", 4) == 0) return none;
+            return r;
 
         default:
-            return 0;
-    }
-
-    if (keyword[0] == 'L') {
-        switch (keyword[1]) {
-            case 'B':
-                return(id == LGRS
-                    or id == NUMLX
-                    or id == NUMLY
-                    or id == NUMLZ
-                    ) ? 4 : 0;
-                ;
-
-            case 'C':
-                return(id == LGRS
-                    or id == WGNAMES
-                    or id == NUMLX
-                    or id == NUMLY
-                    or id == NUMLZ
-                ) ? 4 : 0
-                ;
-
-            case 'W':
-                return(id == LGRS
-                    or id == WGNAMES
-                ) ? 2 : 0
-                ;
-        }
-
-        return 0;
+            return none;
     }
+}
 
-    const auto key = std::string(keyword, 8);
+std::uint8_t identifier_bit(const char* id) noexcept (true) {
+    if (is(id, "WGNAMES ")) return WGNAMES;
+    if (is(id, "NUMS    ")) return NUMS;
+    if (is(id, "LGRS    ")) return LGRS;
+    if (is(id, "NUMLX   ")) return NUMLX;
+    if (is(id, "NUMLY   ")) return NUMLY;
+    if (is(id, "NUMLZ   ")) return NUMLZ;
+    return 0;
+}
 
-    if (key[0] == 'N') {
-          if (key == "NEWTON  ") return 0;
-          if (key == "NAIMFRAC") return 0;
-          if (key == "NLINEARS") return 0;
-          if (key == "NLINSMIN") return 0;
-          if (key == "NLINSMAX") return 0;
-          return id == WGNAMES ? 1 : 0;
-    }
+}
 
-    if (key[0] == 'S') {
-        if (key == "STEPTYPE") return 0;
-        const auto prefix = key.substr(0, 4);
-        if (prefix == "SGAS") return 0;
-        if (prefix == "SOIL") return 0;
-        if (prefix == "SWAT") return 0;
+int ecl3_params_identifies(const char* type, const char* keyword) {
+    const auto r = classify(rules(), keyword);
+    return (r.mask & identifier_bit(type)) ? r.count : 0;
+}
 
-        return (id == WGNAMES or id == NUMS) ? 2 : 0;
+int ecl3_params_classify(const char* keywords,
+                         std::size_t count,
+                         std::uint8_t* masks,
+                         std::uint8_t* counts) {
+    if (not keywords or not masks)
+        return ECL3_INVALID_ARGS;
+
+    const auto& table = rules();
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto r = classify(table, keywords + 8 * i);
+        masks[i] = r.mask;
+        if (counts) counts[i] = r.count;
     }
 
-    return 0;
+    return ECL3_OK;
 }
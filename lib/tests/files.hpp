@@ -0,0 +1,119 @@
+#ifndef ECL3_TESTS_FILES_HPP
+#define ECL3_TESTS_FILES_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <endianness/endianness.h>
+
+#include <ecl3/keyword.h>
+
+namespace {
+
+/*
+ * Remove the file at path both when constructed and destroyed, so that a test
+ * starts from a clean slate and a failing REQUIRE does not leave files behind
+ */
+struct temporary_file {
+    explicit temporary_file(std::string p) : path(std::move(p)) {
+        std::remove(this->path.c_str());
+    }
+
+    ~temporary_file() {
+        std::remove(this->path.c_str());
+    }
+
+    temporary_file(const temporary_file&) = delete;
+    temporary_file& operator = (const temporary_file&) = delete;
+
+    const std::string path;
+};
+
+/*
+ * A minimal writer for unformatted files, so that tests can generate files in
+ * any byte order
+ */
+class writer {
+public:
+    writer(const std::string& path, int order, int marker = 4) :
+        fs(path, std::ios::binary | std::ios::out),
+        order(order),
+        marker(marker)
+    {}
+
+    template < typename T >
+    void array(const char* kw, const char* type, const std::vector< T >& xs) {
+        int typeid_;
+        ecl3_typeid(type, &typeid_);
+        int blocksize;
+        ecl3_block_size(typeid_, &blocksize);
+
+        char header[16];
+        std::memcpy(header, kw, 8);
+        this->put(header + 8, std::int32_t(xs.size()));
+        std::memcpy(header + 12, type, 4);
+        this->record(header, sizeof(header));
+
+        for (std::size_t i = 0; i < xs.size(); i += blocksize) {
+            const auto n = std::min(xs.size() - i, std::size_t(blocksize));
+            std::vector< char > block(n * sizeof(T));
+            for (std::size_t k = 0; k < n; ++k)
+                this->put(block.data() + k * sizeof(T), xs[i + k]);
+            this->record(block.data(), block.size());
+        }
+    }
+
+private:
+    std::ofstream fs;
+    int order;
+    int marker;
+
+    template < typename T >
+    void put(char* dst, T x) {
+        static_assert(sizeof(T) == 4 or sizeof(T) == 8, "4- or 8-byte types");
+        std::memcpy(dst, &x, sizeof(x));
+        if (order == ecl3_native_byteorder()) return;
+
+        if (sizeof(T) == 4) {
+            std::uint32_t tmp;
+            std::memcpy(&tmp, dst, sizeof(tmp));
+            tmp = bswap32(tmp);
+            std::memcpy(dst, &tmp, sizeof(tmp));
+        } else {
+            std::uint64_t tmp;
+            std::memcpy(&tmp, dst, sizeof(tmp));
+            tmp = bswap64(tmp);
+            std::memcpy(dst, &tmp, sizeof(tmp));
+        }
+    }
+
+    void record(const char* src, std::size_t len) {
+        char head[8];
+        if (this->marker == 4)
+            this->put(head, std::int32_t(len));
+        else
+            this->put(head, std::int64_t(len));
+
+        this->fs.write(head, this->marker);
+        this->fs.write(src, len);
+        this->fs.write(head, this->marker);
+    }
+};
+
+std::string file_bytes(const std::string& path) {
+    std::ifstream fs(path, std::ios::binary);
+    return std::string(
+        std::istreambuf_iterator< char >(fs),
+        std::istreambuf_iterator< char >()
+    );
+}
+
+}
+
+#endif // ECL3_TESTS_FILES_HPP
@@ -0,0 +1,1235 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#include <catch2/catch.hpp>
+#include <endianness/endianness.h>
+
+#include <ecl3/io.hpp>
+#include <ecl3/compressed.hpp>
+#include <ecl3/keyword.h>
+#include <ecl3/mmap.hpp>
+#include <ecl3/prefetch.hpp>
+#include <ecl3/toc.hpp>
+#include <ecl3/typed.hpp>
+
+#include "files.hpp"
+
+#if defined(ECL3_HAVE_ZLIB)
+    #include <zlib.h>
+#endif
+
+#if !defined(_WIN32)
+    #include <sys/stat.h>
+    #include <ecl3/fd.hpp>
+#endif
+
+namespace {
+
+template < typename T >
+std::vector< T > values(const ecl3::raw_array& x) {
+    std::vector< T > xs(x.count);
+    std::memcpy(xs.data(), x.body.data(), x.body.size());
+    return xs;
+}
+
+std::string keyword(const ecl3::raw_array& x) {
+    return std::string(x.keyword.begin(), x.keyword.end());
+}
+
+}
+
+using namespace Catch::Matchers;
+
+TEST_CASE("stream_reader detects and reads both byte orders") {
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const temporary_file tmp("ecl3-io-byteorder.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i) - 1000;
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, order);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    INFO("order = " << order);
+    ecl3::stream_reader< std::ifstream > fs(path);
+    CHECK(fs.byteorder() == 0);
+
+    const auto& x = fs.next();
+    CHECK(fs.byteorder() == order);
+    CHECK(keyword(x) == "INTS    ");
+    CHECK(x.count == 2500);
+    CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+
+    const auto& y = fs.next();
+    CHECK(keyword(y) == "DOUBLES ");
+    CHECK_THAT(values< double >(y), Equals(doubles));
+
+    CHECK(fs.next().empty());
+}
+
+TEST_CASE("raw bodies are in the file's byte order") {
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const temporary_file tmp("ecl3-io-raw.bin");
+    const auto& path = tmp.path;
+    const auto reals = std::vector< float >{ 1.5f, -2.25f, 3.0f, 0.1f, 2e30f };
+
+    {
+        writer w(path, order);
+        w.array("PARAMS  ", "REAL", reals);
+    }
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    fs.raw_bodies(true);
+    const auto& x = fs.next();
+    REQUIRE(fs.byteorder() == order);
+
+    auto result = std::vector< double >(reals.size());
+    const auto err = ecl3_get_native_as_from(
+        result.data(),
+        x.body.data(),
+        ECL3_REAL,
+        ECL3_NATIVE_DOUBLE,
+        reals.size(),
+        fs.byteorder()
+    );
+    CHECK(err == ECL3_OK);
+
+    const auto expected = std::vector< double >(reals.begin(), reals.end());
+    CHECK_THAT(result, Equals(expected));
+}
+
+TEST_CASE("stream_reader detects and reads 8-byte record markers") {
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const temporary_file tmp("ecl3-io-marker.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2100);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i * 7);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, order, 8);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    INFO("order = " << order);
+    ecl3::stream_reader< std::ifstream > fs(path);
+    CHECK(fs.record_marker_size() == 0);
+
+    const auto& x = fs.next();
+    CHECK(fs.record_marker_size() == 8);
+    CHECK(fs.byteorder() == order);
+    CHECK(keyword(x) == "INTS    ");
+    CHECK(x.count == 2100);
+    CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+
+    const auto& y = fs.next();
+    CHECK(keyword(y) == "DOUBLES ");
+    CHECK_THAT(values< double >(y), Equals(doubles));
+
+    CHECK(fs.next().empty());
+}
+
+TEST_CASE("stream_reader reports 4-byte record markers") {
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const temporary_file tmp("ecl3-io-marker4.bin");
+    const auto& path = tmp.path;
+
+    {
+        writer w(path, order);
+        w.array("INTS    ", "INTE", std::vector< std::int32_t >{ 1, 2, 3 });
+    }
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    const auto& x = fs.next();
+    CHECK(fs.record_marker_size() == 4);
+    CHECK(x.count == 3);
+}
+
+TEST_CASE("scan lists headers and offsets without reading bodies") {
+    const auto marker = GENERATE(4, 8);
+    const temporary_file tmp("ecl3-io-scan.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, ECL3_BIG_ENDIAN, marker);
+        w.array("INTS    ", "INTE", ints);
+        w.array("EMPTY   ", "INTE", std::vector< std::int32_t >());
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    const auto t = ecl3::scan(path);
+    CHECK(t.byteorder == ECL3_BIG_ENDIAN);
+    CHECK(t.record_marker_size == marker);
+    REQUIRE(t.entries.size() == 3);
+
+    const auto header = 16 + 2 * marker;
+    const auto& e = t.entries;
+    CHECK(e[0].count == 2500);
+    CHECK(e[0].offset == 0);
+    CHECK(e[1].count == 0);
+    CHECK(e[1].offset == header + 2500 * 4 + 3 * 2 * marker);
+    CHECK(e[2].count == 3);
+    CHECK(e[2].offset == e[1].offset + header);
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    fs.seek(e[2].offset);
+    const auto& x = fs.next();
+    CHECK(keyword(x) == "DOUBLES ");
+    CHECK_THAT(values< double >(x), Equals(doubles));
+    CHECK(fs.next().empty());
+
+    fs.seek(e[0].offset);
+    CHECK(keyword(fs.next_header()) == "INTS    ");
+    CHECK(keyword(fs.next()) == "EMPTY   ");
+
+    SECTION("headers without bodies can not be unget'd") {
+        fs.seek(e[0].offset);
+        CHECK(keyword(fs.next_header()) == "INTS    ");
+        CHECK(not fs.unget());
+        CHECK(keyword(fs.next()) == "EMPTY   ");
+        CHECK(fs.unget());
+        CHECK(keyword(fs.next()) == "EMPTY   ");
+        CHECK(keyword(fs.next_header()) == "DOUBLES ");
+        CHECK(not fs.unget());
+        CHECK(fs.next().empty());
+    }
+
+    SECTION("peeked arrays keep their bodies, and can be unget'd") {
+        fs.seek(e[2].offset);
+        CHECK(fs.peek().count == 3);
+        const auto& x = fs.next_header();
+        CHECK_THAT(values< double >(x), Equals(doubles));
+        CHECK(fs.unget());
+        CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+    }
+}
+
+TEST_CASE("table-of-contents sidecar is reused until the file changes") {
+    const temporary_file tmp("ecl3-io-sidecar.bin");
+    const auto& path = tmp.path;
+    const temporary_file index(ecl3::toc_sidecar_path(path));
+    const auto& sidecar = index.path;
+
+    {
+        writer w(path, ECL3_LITTLE_ENDIAN);
+        w.array("INTS    ", "INTE", std::vector< std::int32_t >{ 1, 2, 3 });
+    }
+
+    ecl3::toc t;
+    CHECK(not ecl3::read_toc(path, t));
+
+    const auto scanned = ecl3::load_toc(path);
+    REQUIRE(ecl3::read_toc(path, t));
+    CHECK(t.byteorder == scanned.byteorder);
+    CHECK(t.record_marker_size == scanned.record_marker_size);
+    REQUIRE(t.entries.size() == 1);
+    CHECK(t.entries[0].keyword == scanned.entries[0].keyword);
+    CHECK(t.entries[0].count == 3);
+
+    {
+        writer w(path, ECL3_LITTLE_ENDIAN);
+        w.array("INTS    ", "INTE", std::vector< std::int32_t >{ 1, 2, 3 });
+        w.array("MORE    ", "INTE", std::vector< std::int32_t >{ 4 });
+    }
+
+    CHECK(not ecl3::read_toc(path, t));
+    CHECK(ecl3::load_toc(path).entries.size() == 2);
+    REQUIRE(ecl3::read_toc(path, t));
+    CHECK(t.entries.size() == 2);
+
+    /* the sidecar is replaced by renaming a fresh file over it */
+    CHECK(ecl3::write_toc(path, t));
+    ecl3::toc again;
+    REQUIRE(ecl3::read_toc(path, again));
+    CHECK(again.entries.size() == 2);
+}
+
+TEST_CASE("mmap_reader views arrays and decodes them on request") {
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const auto marker = GENERATE(4, 8);
+    const temporary_file tmp("ecl3-io-mmap.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i) - 1000;
+    const auto reals = std::vector< float >{ 1.5f, -2.25f, 3.0f };
+
+    {
+        writer w(path, order, marker);
+        w.array("INTS    ", "INTE", ints);
+        w.array("REALS   ", "REAL", reals);
+    }
+
+    INFO("order = " << order << ", marker = " << marker);
+    ecl3::mmap_reader fs(path);
+    fs.advise(ecl3::mmap_reader::sequential);
+
+    const auto& x = fs.next();
+    CHECK(fs.byteorder() == order);
+    CHECK(fs.record_marker_size() == marker);
+    CHECK(std::string(x.keyword.begin(), x.keyword.end()) == "INTS    ");
+    CHECK(x.count == 2500);
+    REQUIRE(x.blocks() == 3);
+    CHECK(x.block(0).count == 1000);
+    CHECK(x.block(2).count == 500);
+    CHECK(x.block(1).data == x.begin + marker + 4000 + 2 * marker);
+
+    auto decoded = std::vector< std::int32_t >(x.count);
+    x.decode(decoded.data());
+    CHECK_THAT(decoded, Equals(ints));
+
+    const auto& y = fs.next();
+    auto doubles = std::vector< double >(y.count);
+    y.decode_as(doubles.data(), ECL3_NATIVE_DOUBLE);
+    const auto expected = std::vector< double >(reals.begin(), reals.end());
+    CHECK_THAT(doubles, Equals(expected));
+
+    auto raw = std::vector< unsigned char >(y.count * 4);
+    y.copy_raw(raw.data());
+    auto converted = std::vector< float >(y.count);
+    ecl3_get_native_from(converted.data(), raw.data(), ECL3_REAL, y.count,
+                         order);
+    CHECK_THAT(converted, Equals(reals));
+
+    CHECK(fs.next().empty());
+    CHECK(fs.tell() == fs.size());
+
+    fs.seek(0);
+    CHECK(fs.next().count == 2500);
+    fs.unget();
+    CHECK(fs.next().count == 2500);
+    CHECK(fs.next().count == 3);
+}
+
+TEST_CASE("mmap_reader detects broken block markers when decoding") {
+    const temporary_file tmp("ecl3-io-mmap-broken.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("INTS    ", "INTE", std::vector< std::int32_t >{ 1, 2, 3 });
+    }
+    {
+        /* corrupt the tail of the body record */
+        std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+        fs.seekp(-1, std::ios::end);
+        fs.put(char(0xFF));
+    }
+
+    ecl3::mmap_reader fs(path);
+    const auto& x = fs.next();
+    CHECK(x.count == 3);
+
+    auto decoded = std::vector< std::int32_t >(x.count);
+    CHECK_THROWS_AS(x.decode(decoded.data()), ecl3::head_tail_error);
+}
+
+TEST_CASE("stream_reader skips arrays not selected") {
+    const temporary_file tmp("ecl3-io-select.bin");
+    const auto& path = tmp.path;
+    const auto ints = std::vector< std::int32_t >(2500, 7);
+
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("SEQHDR  ", "INTE", std::vector< std::int32_t >{ 1 });
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("PARAMS  ", "REAL", std::vector< float >{ 1.5f });
+        w.array("SKIPPED ", "DOUB", std::vector< double >{ 1.0, 2.0 });
+        w.array("SEQHDR  ", "INTE", std::vector< std::int32_t >{ 2 });
+    }
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    fs.select({ "SEQHDR", "PARAMS" });
+
+    CHECK(keyword(fs.next()) == "SEQHDR  ");
+    const auto& x = fs.next();
+    CHECK(keyword(x) == "PARAMS  ");
+    CHECK_THAT(values< float >(x), Equals(std::vector< float >{ 1.5f }));
+    fs.unget();
+    CHECK(keyword(fs.next()) == "PARAMS  ");
+    CHECK_THAT(values< std::int32_t >(fs.next()),
+               Equals(std::vector< std::int32_t >{ 2 }));
+    CHECK(fs.next().empty());
+
+    fs.seek(0);
+    std::vector< std::int64_t > counts;
+    fs.filter([](const ecl3::raw_array& a) { return a.count > 1; });
+    while (true) {
+        const auto& a = fs.next();
+        if (a.empty()) break;
+        const auto elemsize = a.type[0] == 'D' ? 8 : 4;
+        CHECK(std::int64_t(a.body.size()) == a.count * elemsize);
+        counts.push_back(a.count);
+    }
+    CHECK_THAT(counts, Equals(std::vector< std::int64_t >{ 2500, 2 }));
+
+    CHECK_THROWS_AS(fs.select({ "TOOLONGKW" }), std::invalid_argument);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("stream_reader drains unselected arrays on pipes") {
+    const temporary_file tmp("ecl3-io-fifo");
+    const auto& path = tmp.path;
+    REQUIRE(mkfifo(path.c_str(), 0600) == 0);
+
+    const auto ints = std::vector< std::int32_t >(25000, 7);
+    std::thread producer([&] {
+        writer w(path, ECL3_LITTLE_ENDIAN);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("KEEP    ", "INTE", std::vector< std::int32_t >{ 1, 2 });
+        w.array("SKIPPED ", "INTE", ints);
+    });
+
+    {
+        ecl3::stream_reader< std::ifstream > fs(path);
+        fs.select({ "KEEP" });
+        const auto& x = fs.next();
+        CHECK(keyword(x) == "KEEP    ");
+        CHECK_THAT(values< std::int32_t >(x),
+                   Equals(std::vector< std::int32_t >{ 1, 2 }));
+        CHECK(fs.next().empty());
+    }
+
+    producer.join();
+}
+#endif
+
+TEST_CASE("stream_reader reuses its buffers between arrays") {
+    const temporary_file tmp("ecl3-io-reuse.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        for (int i = 0; i < 8; ++i)
+            w.array("BIG     ", "DOUB", std::vector< double >(5000, 1.0));
+        for (int i = 0; i < 50; ++i)
+            w.array("SMALL   ", "INTE", std::vector< std::int32_t >{ 1, 2 });
+    }
+
+    /*
+     * Once every buffer in the ring has been used for a big array, reading
+     * smaller arrays should only cycle through the same buffers
+     */
+    ecl3::stream_reader< std::ifstream > fs(path);
+    std::vector< const unsigned char* > warm;
+    for (int i = 0; i < 8; ++i)
+        warm.push_back(fs.next().body.data());
+
+    for (int i = 0; i < 50; ++i) {
+        const auto* data = fs.next().body.data();
+        const auto found = std::find(warm.begin(), warm.end(), data);
+        CHECK(found != warm.end());
+    }
+    CHECK(fs.next().empty());
+}
+
+TEST_CASE("stream_reader fails on truncated headers") {
+    const temporary_file tmp("ecl3-io-truncated.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("FIRST   ", "INTE", std::vector< std::int32_t >{ 1 });
+    }
+    {
+        std::ofstream fs(path, std::ios::binary | std::ios::app);
+        fs.write("\0\0\0\x10SECO", 8);
+    }
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    CHECK(fs.next().count == 1);
+    CHECK_THROWS_AS(fs.next(), ecl3::header_error);
+}
+
+TEST_CASE("stream_reader fails on truncated bodies that are skipped") {
+    const temporary_file tmp("ecl3-io-truncated-body.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("FIRST   ", "INTE", std::vector< std::int32_t >{ 1 });
+        w.array("SKIPPED ", "INTE", std::vector< std::int32_t >(2500, 7));
+    }
+    auto bytes = file_bytes(path);
+    bytes.resize(bytes.size() - 100);
+    {
+        std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+        fs.write(bytes.data(), std::streamsize(bytes.size()));
+    }
+
+    SECTION("std::ifstream") {
+        ecl3::stream_reader< std::ifstream > fs(path);
+        fs.select({ "FIRST" });
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next(), Contains("end-of-file"));
+
+        fs.seek(0);
+        CHECK(keyword(fs.next_header()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next_header(), Contains("end-of-file"));
+    }
+
+    SECTION("buffer_stream") {
+        using stream = ecl3::buffer_stream;
+        ecl3::stream_reader< stream > fs(bytes.data(), bytes.size());
+        fs.select({ "FIRST" });
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next(), Contains("end-of-file"));
+    }
+
+    SECTION("prefetch_stream") {
+        using stream = ecl3::prefetch_stream< std::ifstream >;
+        ecl3::stream_reader< stream > fs(path, 2, 64);
+        fs.select({ "FIRST" });
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next(), Contains("end-of-file"));
+    }
+
+    SECTION("compressed_stream") {
+        ecl3::stream_reader< ecl3::compressed_stream > fs(path);
+        fs.select({ "FIRST" });
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next(), Contains("end-of-file"));
+    }
+
+#if !defined(_WIN32)
+    SECTION("fd_stream") {
+        ecl3::stream_reader< ecl3::fd_stream > fs(path, 64);
+        fs.select({ "FIRST" });
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        CHECK_THROWS_WITH(fs.next(), Contains("end-of-file"));
+    }
+#endif
+}
+
+#if !defined(_WIN32)
+TEST_CASE("fd_stream reads arrays with any buffer size") {
+    const auto bufsize = GENERATE(as< std::size_t >(), 1, 7, 100, 1 << 20);
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    const temporary_file tmp("ecl3-io-fd.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i) - 1000;
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, order);
+        w.array("INTS    ", "INTE", ints);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    INFO("bufsize = " << bufsize << ", order = " << order);
+    ecl3::stream_reader< ecl3::fd_stream > fs(path, bufsize);
+
+    const auto& x = fs.next();
+    CHECK(fs.byteorder() == order);
+    CHECK(keyword(x) == "INTS    ");
+    CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+
+    const auto offset = fs.tell();
+    CHECK(keyword(fs.next_header()) == "SKIPPED ");
+
+    const auto& y = fs.next();
+    CHECK(keyword(y) == "DOUBLES ");
+    CHECK_THAT(values< double >(y), Equals(doubles));
+    CHECK(fs.next().empty());
+    CHECK(fs.next().empty());
+
+    fs.seek(offset);
+    fs.select({ "DOUBLES" });
+    CHECK(keyword(fs.next()) == "DOUBLES ");
+    CHECK(fs.next().empty());
+}
+
+TEST_CASE("fd_stream drains unselected arrays on pipes") {
+    const temporary_file tmp("ecl3-io-fd-fifo");
+    const auto& path = tmp.path;
+    REQUIRE(mkfifo(path.c_str(), 0600) == 0);
+
+    const auto ints = std::vector< std::int32_t >(25000, 7);
+    std::thread producer([&] {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("KEEP    ", "INTE", std::vector< std::int32_t >{ 1, 2 });
+    });
+
+    {
+        ecl3::stream_reader< ecl3::fd_stream > fs(path, 4096);
+        fs.select({ "KEEP" });
+        const auto& x = fs.next();
+        CHECK(keyword(x) == "KEEP    ");
+        CHECK_THAT(values< std::int32_t >(x),
+                   Equals(std::vector< std::int32_t >{ 1, 2 }));
+        CHECK(fs.next().empty());
+    }
+
+    producer.join();
+}
+
+TEST_CASE("fd_stream reads already-open descriptors") {
+    const temporary_file tmp("ecl3-io-fd-open.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("FIRST   ", "INTE", std::vector< std::int32_t >{ 1 });
+        w.array("SECOND  ", "INTE", std::vector< std::int32_t >{ 2, 3 });
+    }
+
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    REQUIRE(fd != -1);
+    {
+        ecl3::stream_reader< ecl3::fd_stream > fs(fd);
+        CHECK(keyword(fs.next()) == "FIRST   ");
+        const auto offset = fs.tell();
+        CHECK(keyword(fs.next()) == "SECOND  ");
+        CHECK(fs.next().empty());
+
+        fs.seek(offset);
+        CHECK(fs.next().count == 2);
+    }
+
+    /* the descriptor is not owned by the reader, and is still open */
+    CHECK(::lseek(fd, 0, SEEK_SET) == 0);
+    ::close(fd);
+}
+
+TEST_CASE("fd_stream closes its descriptor when re-opened") {
+    const temporary_file tmp("ecl3-io-fd-reopen.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("FIRST   ", "INTE", std::vector< std::int32_t >{ 1 });
+    }
+
+    /* descriptors are allocated lowest-first, so leaks show up as new ones */
+    ecl3::fd_stream s;
+    s.open(path);
+    const auto free = ::open(path.c_str(), O_RDONLY);
+    REQUIRE(free != -1);
+    ::close(free);
+
+    s.open(path);
+    s.open(path, 7);
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    CHECK(fd == free);
+    ::close(fd);
+
+    char head[12];
+    REQUIRE(s.read(head, sizeof(head)) == sizeof(head));
+    CHECK(std::string(head + 4, 8) == "FIRST   ");
+}
+
+TEST_CASE("fd_stream reports missing files as invalid arguments") {
+    using reader = ecl3::stream_reader< ecl3::fd_stream >;
+    CHECK_THROWS_AS(reader("ecl3-io-no-such-file"), std::invalid_argument);
+}
+#endif
+
+TEST_CASE("prefetch_stream reads ahead in bounded blocks") {
+    const auto depth = GENERATE(as< std::size_t >(), 1, 3);
+    const auto blocksize = GENERATE(as< std::size_t >(), 5, 4096, 1 << 20);
+    const temporary_file tmp("ecl3-io-prefetch.bin");
+    const auto& path = tmp.path;
+
+    std::vector< std::int32_t > ints(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i) - 1000;
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, ECL3_LITTLE_ENDIAN);
+        w.array("INTS    ", "INTE", ints);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    INFO("depth = " << depth << ", blocksize = " << blocksize);
+    using stream = ecl3::prefetch_stream< std::ifstream >;
+    ecl3::stream_reader< stream > fs(path, depth, blocksize);
+
+    const auto& x = fs.next();
+    CHECK(keyword(x) == "INTS    ");
+    CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+
+    const auto offset = fs.tell();
+    fs.select({ "DOUBLES" });
+    const auto& y = fs.next();
+    CHECK(keyword(y) == "DOUBLES ");
+    CHECK_THAT(values< double >(y), Equals(doubles));
+    CHECK(fs.next().empty());
+
+    fs.seek(offset);
+    fs.filter(nullptr);
+    CHECK(keyword(fs.next()) == "SKIPPED ");
+    CHECK(keyword(fs.next()) == "DOUBLES ");
+    CHECK(fs.next().empty());
+
+    fs.seek(0);
+    CHECK(fs.next().count == 2500);
+}
+
+TEST_CASE("prefetch_stream skips within and past the read-ahead") {
+    const temporary_file tmp("ecl3-io-prefetch-skip.bin");
+    const auto& path = tmp.path;
+    {
+        std::ofstream fs(path, std::ios::binary);
+        for (int i = 0; i < 1000; ++i)
+            fs.put(char(i % 251));
+    }
+
+    using stream = ecl3::prefetch_stream< std::ifstream >;
+    using traits = ecl3::stream_traits< stream >;
+    stream s;
+    s.open(path, 3, 16);
+    CHECK_THROWS_AS(s.open(path), std::logic_error);
+
+    const auto next = [&] {
+        char c;
+        REQUIRE(traits::read(s, &c, 1) == 1);
+        return int(static_cast< unsigned char >(c));
+    };
+
+    /* skips within the window of 3 * 16 bytes, across block boundaries */
+    for (int i = 0; i < 20; ++i) {
+        traits::skip(s, 10);
+        CHECK(s.tell() == std::uint64_t(11 * i + 10));
+        CHECK(next() == (11 * i + 10) % 251);
+    }
+
+    /* past the window */
+    const auto pos = s.tell();
+    traits::skip(s, 500);
+    CHECK(s.tell() == pos + 500);
+    CHECK(next() == int((pos + 500) % 251));
+
+    traits::skip(s, 1000 - s.tell());
+    char c;
+    CHECK(traits::read(s, &c, 1) == 0);
+
+    s.seek(990);
+    CHECK_THROWS_WITH(traits::skip(s, 20), Contains("end-of-file"));
+    s.seek(900);
+    CHECK_THROWS_WITH(traits::skip(s, 200), Contains("end-of-file"));
+}
+
+TEST_CASE("compressed_stream reads uncompressed files as-is") {
+    const temporary_file tmp("ecl3-io-plain.bin");
+    const auto& path = tmp.path;
+    const auto ints = std::vector< std::int32_t >(2500, 5);
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("INTS    ", "INTE", ints);
+        w.array("MORE    ", "INTE", std::vector< std::int32_t >{ 1 });
+    }
+
+    ecl3::stream_reader< ecl3::compressed_stream > fs(path);
+    const auto& x = fs.next();
+    CHECK(keyword(x) == "INTS    ");
+    CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+    CHECK(keyword(fs.next()) == "MORE    ");
+    CHECK(fs.next().empty());
+
+    fs.seek(0);
+    fs.select({ "MORE" });
+    CHECK(keyword(fs.next()) == "MORE    ");
+}
+
+#if defined(ECL3_HAVE_ZLIB)
+namespace {
+
+void gzip(const std::string& src, const std::string& dst, const char* mode) {
+    std::ifstream fs(src, std::ios::binary);
+    const auto bytes = std::vector< char >(
+        std::istreambuf_iterator< char >(fs),
+        std::istreambuf_iterator< char >()
+    );
+
+    auto* gz = gzopen(dst.c_str(), mode);
+    REQUIRE(gz);
+    const auto len = static_cast< unsigned >(bytes.size());
+    REQUIRE(gzwrite(gz, bytes.data(), len) == int(len));
+    gzclose(gz);
+}
+
+}
+
+TEST_CASE("compressed_stream reads gzip files") {
+    const temporary_file tmp("ecl3-io-gzip.bin");
+    const auto& path = tmp.path;
+    const temporary_file gz(path + ".gz");
+    const auto& gzpath = gz.path;
+
+    std::vector< std::int32_t > ints(25000);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+
+    {
+        writer w(path, ECL3_LITTLE_ENDIAN);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+    gzip(path, gzpath, "wb");
+
+    SECTION("single member") {
+        ecl3::stream_reader< ecl3::compressed_stream > fs(gzpath);
+        const auto& x = fs.next();
+        CHECK(fs.byteorder() == ECL3_LITTLE_ENDIAN);
+        CHECK(keyword(x) == "INTS    ");
+        CHECK_THAT(values< std::int32_t >(x), Equals(ints));
+        const auto offset = fs.tell();
+        CHECK(keyword(fs.next()) == "DOUBLES ");
+        CHECK(fs.next().empty());
+
+        fs.seek(offset);
+        CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+
+        fs.seek(0);
+        fs.select({ "DOUBLES" });
+        CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+    }
+
+    SECTION("concatenated members") {
+        gzip(path, gzpath, "ab");
+        ecl3::stream_reader< ecl3::compressed_stream > fs(gzpath);
+        for (int i = 0; i < 2; ++i) {
+            CHECK(keyword(fs.next()) == "INTS    ");
+            CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+        }
+        CHECK(fs.next().empty());
+    }
+
+    SECTION("with read-ahead") {
+        using stream = ecl3::prefetch_stream< ecl3::compressed_stream >;
+        ecl3::stream_reader< stream > fs(gzpath, 2, 4096);
+        CHECK_THAT(values< std::int32_t >(fs.next()), Equals(ints));
+        CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+        CHECK(fs.next().empty());
+    }
+
+    SECTION("skipping past the end") {
+        ecl3::compressed_stream s;
+        s.open(gzpath);
+        CHECK_THROWS_WITH(s.skip(1 << 20), Contains("end-of-file"));
+    }
+
+    SECTION("truncated") {
+        std::ifstream in(gzpath, std::ios::binary);
+        auto bytes = std::vector< char >(
+            std::istreambuf_iterator< char >(in),
+            std::istreambuf_iterator< char >()
+        );
+        in.close();
+        bytes.resize(bytes.size() / 2);
+        std::ofstream out(gzpath, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), std::streamsize(bytes.size()));
+        out.close();
+
+        ecl3::stream_reader< ecl3::compressed_stream > fs(gzpath);
+        CHECK_THROWS_AS(fs.next(), std::runtime_error);
+    }
+}
+#endif
+
+TEST_CASE("buffer_stream reads arrays from memory") {
+    const temporary_file tmp("ecl3-io-buffer.bin");
+    const auto& path = tmp.path;
+    const auto ints = std::vector< std::int32_t >(2500, 5);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+    {
+        writer w(path, ECL3_LITTLE_ENDIAN, 8);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+    const auto bytes = file_bytes(path);
+
+    ecl3::stream_reader< ecl3::buffer_stream > fs(bytes.data(), bytes.size());
+    CHECK_THAT(values< std::int32_t >(fs.next()), Equals(ints));
+    CHECK(fs.record_marker_size() == 8);
+    const auto offset = fs.tell();
+    CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+    CHECK(fs.next().empty());
+    CHECK(fs.tell() == bytes.size());
+
+    fs.seek(0);
+    fs.select({ "DOUBLES" });
+    CHECK(fs.next().count == 3);
+
+    fs.seek(offset);
+    CHECK(fs.next_header().count == 3);
+    CHECK(fs.next().empty());
+
+    ecl3::stream_reader< ecl3::buffer_stream > empty(nullptr, 0);
+    CHECK(empty.next().empty());
+
+    using reader = ecl3::stream_reader< ecl3::buffer_stream >;
+    CHECK_THROWS_AS(reader(nullptr, 10), std::invalid_argument);
+}
+
+TEST_CASE("istream_ref reads already-open streams") {
+    const temporary_file tmp("ecl3-io-istream.bin");
+    const auto& path = tmp.path;
+    const auto ints = std::vector< std::int32_t >(2500, 5);
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("INTS    ", "INTE", ints);
+    }
+    const auto bytes = file_bytes(path);
+
+    std::istringstream is(bytes);
+    is.exceptions(std::ios::failbit);
+    {
+        ecl3::stream_reader< ecl3::istream_ref > fs(is);
+        fs.select({ "INTS" });
+        CHECK_THAT(values< std::int32_t >(fs.next()), Equals(ints));
+        CHECK(fs.next().empty());
+    }
+    CHECK(is.exceptions() == std::ios::failbit);
+}
+
+TEST_CASE("stream_reader peeks ahead and ungets several arrays") {
+    const temporary_file tmp("ecl3-io-peek.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        for (std::int32_t i = 0; i < 20; ++i)
+            w.array("ARRAY   ", "INTE", std::vector< std::int32_t >{ i });
+    }
+
+    const auto value = [](const ecl3::raw_array& x) {
+        return values< std::int32_t >(x).at(0);
+    };
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    CHECK(not fs.unget());
+
+    CHECK(value(fs.peek()) == 0);
+    CHECK(value(fs.peek(1)) == 1);
+    CHECK(value(fs.peek(9)) == 9);
+    CHECK(value(fs.peek()) == 0);
+
+    for (std::int32_t i = 0; i < 10; ++i)
+        CHECK(value(fs.next()) == i);
+
+    CHECK(fs.unget());
+    CHECK(fs.unget());
+    CHECK(value(fs.next()) == 8);
+    CHECK(value(fs.peek()) == 9);
+    CHECK(value(fs.next()) == 9);
+    CHECK(value(fs.next()) == 10);
+
+    CHECK(fs.peek(9).empty());
+    CHECK(value(fs.peek(8)) == 19);
+    for (std::int32_t i = 11; i < 20; ++i)
+        CHECK(value(fs.next()) == i);
+
+    CHECK(fs.peek().empty());
+    CHECK(fs.next().empty());
+    CHECK(fs.unget());
+    CHECK(value(fs.next()) == 19);
+    CHECK(fs.next().empty());
+
+    fs.seek(0);
+    CHECK(not fs.unget());
+    CHECK(value(fs.next()) == 0);
+}
+
+TEST_CASE("stream_reader decodes large arrays in parallel") {
+    const temporary_file tmp("ecl3-io-parallel.bin");
+    const auto& path = tmp.path;
+    auto ints = std::vector< std::int32_t >(25500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+    auto bytes = file_bytes(path);
+
+    using reader = ecl3::stream_reader< ecl3::buffer_stream >;
+    const auto threads = GENERATE(2u, 3u, 8u);
+
+    SECTION("the decoded arrays are the same as when decoded serially") {
+        reader fs(bytes.data(), bytes.size());
+        fs.parallel_decode(threads, 1000);
+        CHECK_THAT(values< std::int32_t >(fs.next()), Equals(ints));
+        CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+        CHECK(fs.next().empty());
+    }
+
+    SECTION("raw bodies are copied in parallel") {
+        reader serial(bytes.data(), bytes.size());
+        serial.raw_bodies(true);
+        const auto expected = serial.next().body;
+
+        reader fs(bytes.data(), bytes.size());
+        fs.raw_bodies(true);
+        fs.parallel_decode(threads, 1000);
+        const auto& x = fs.next();
+        CHECK(x.body.size() == expected.size());
+        CHECK(x.body == expected);
+    }
+
+    SECTION("broken block markers are detected by the workers") {
+        /* header record, then the tail marker of the third block */
+        const auto header = 4 + 16 + 4;
+        const auto block = 4 + 4000 + 4;
+        bytes[header + 3 * block - 1] ^= 0x01;
+
+        reader fs(bytes.data(), bytes.size());
+        fs.parallel_decode(threads, 1000);
+        CHECK_THROWS_AS(fs.next(), ecl3::head_tail_error);
+    }
+}
+
+TEST_CASE("stream_reader streams large bodies in bounded chunks") {
+    const temporary_file tmp("ecl3-io-chunked.bin");
+    const auto& path = tmp.path;
+    auto ints = std::vector< std::int32_t >(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("SKIPPED ", "INTE", ints);
+        w.array("INTS    ", "INTE", ints);
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+
+    struct chunk {
+        std::int64_t first;
+        std::int64_t n;
+    };
+    std::vector< chunk > chunks;
+    std::vector< std::int32_t > collected;
+    const auto collect = [&](const ecl3::raw_array& x,
+                             const unsigned char* data,
+                             std::int64_t first,
+                             std::int64_t n) {
+        CHECK(keyword(x) == "INTS    ");
+        chunks.push_back({ first, n });
+        const auto* xs = reinterpret_cast< const std::int32_t* >(data);
+        collected.insert(collected.end(), xs, xs + n);
+    };
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+    fs.select({ "INTS", "DOUBLES" });
+
+    SECTION("one block at a time") {
+        const auto& x = fs.next_chunked(collect);
+        CHECK(keyword(x) == "INTS    ");
+        CHECK(x.count == 2500);
+        CHECK(x.body.empty());
+        CHECK_THAT(collected, Equals(ints));
+        REQUIRE(chunks.size() == 3);
+        CHECK(chunks[0].first == 0);
+        CHECK(chunks[1].first == 1000);
+        CHECK(chunks[2].first == 2000);
+        CHECK(chunks[2].n == 500);
+    }
+
+    SECTION("chunk sizes are rounded up to whole blocks") {
+        fs.next_chunked(collect, 1500);
+        CHECK_THAT(collected, Equals(ints));
+        REQUIRE(chunks.size() == 2);
+        CHECK(chunks[0].n == 2000);
+        CHECK(chunks[1].n == 500);
+    }
+
+    SECTION("peeked arrays are handed out from memory") {
+        CHECK(fs.peek().count == 2500);
+        fs.next_chunked(collect, 2000);
+        CHECK_THAT(collected, Equals(ints));
+        CHECK(chunks.size() == 2);
+
+        CHECK(fs.unget());
+        CHECK_THAT(values< std::int32_t >(fs.next()), Equals(ints));
+    }
+
+    SECTION("streamed arrays can not be unget'd") {
+        fs.next_chunked(collect);
+        CHECK(not fs.unget());
+        CHECK_THAT(collected, Equals(ints));
+        CHECK(chunks.size() == 3);
+    }
+
+    CHECK_THAT(values< double >(fs.next()), Equals(doubles));
+    CHECK(fs.next_chunked(collect).empty());
+}
+
+TEST_CASE("typed_array views decoded bodies with compile-time types") {
+    static_assert(
+        std::is_same< ecl3::type_traits< ECL3_INTE >::value_type,
+                      std::int32_t >::value,
+        "INTE is int32"
+    );
+    static_assert(
+        std::is_same< ecl3::type_traits< ECL3_LOGI >::value_type,
+                      bool >::value,
+        "LOGI is bool"
+    );
+    static_assert(
+        std::is_same< ecl3::type_traits< ECL3_C042 >::value_type,
+                      ecl3::fixed_string< 42 > >::value,
+        "C042 is a 42-character string"
+    );
+    static_assert(ecl3::element_traits< double >::id == ECL3_DOUB, "");
+    static_assert(ecl3::element_traits< float >::blocksize == 1000, "");
+    static_assert(ecl3::type_traits< ECL3_C011 >::blocksize == 105, "");
+
+    const temporary_file tmp("ecl3-io-typed.bin");
+    const auto& path = tmp.path;
+    const auto floats = std::vector< float >{ 1.5f, -2.25f, 3.0f };
+    const auto logis = std::vector< std::int32_t >{ 0, -1, 1, 0 };
+    const auto strings = std::string("FOPRWOPRGOPRWWCT");
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("FLOATS  ", "REAL", floats);
+        w.array("LOGIS   ", "LOGI", logis);
+        /* 4-character strings, written as if they were integers */
+        std::vector< std::int32_t > names(4);
+        std::memcpy(names.data(), strings.data(), strings.size());
+        for (auto& h : names)
+            if (ecl3_native_byteorder() != ECL3_BIG_ENDIAN) h = bswap32(h);
+        w.array("NAMES   ", "C004", names);
+    }
+
+    ecl3::stream_reader< std::ifstream > fs(path);
+
+    const auto& reals = fs.next();
+    ecl3::typed_array< float > xs(reals);
+    CHECK(xs.size() == 3);
+    CHECK(xs[1] == -2.25f);
+    CHECK(std::vector< float >(xs.data(), xs.data() + xs.size()) == floats);
+    CHECK_THROWS_AS(ecl3::typed_array< double >(reals), ecl3::invalid_type);
+
+    ecl3::typed_array< bool > bs(fs.next());
+    const auto bools = std::vector< bool >(bs.begin(), bs.end());
+    CHECK(bools == std::vector< bool >{ false, true, true, false });
+
+    const auto& c004 = fs.next();
+    ecl3::typed_array< ecl3::fixed_string< 4 > > names(c004);
+    REQUIRE(names.size() == 4);
+    CHECK(names[0].str() == "FOPR");
+    CHECK(names[3].str() == "WWCT");
+    using char8 = ecl3::typed_array< ecl3::fixed_string< 8 > >;
+    CHECK_THROWS_AS(char8(c004), ecl3::invalid_type);
+
+    std::int32_t big;
+    const auto be = std::array< unsigned char, 4 >{ 0, 0, 1, 2 };
+    ecl3::decode(&big, be.data(), 1, ECL3_BIG_ENDIAN);
+    CHECK(big == 258);
+
+    bool b[3];
+    const auto le = std::array< unsigned char, 12 >{
+        0, 0, 0, 0,  1, 0, 0, 0,  0xFF, 0xFF, 0xFF, 0xFF,
+    };
+    ecl3::decode(b, le.data(), 3, ECL3_LITTLE_ENDIAN);
+    CHECK(not b[0]);
+    CHECK(b[1]);
+    CHECK(b[2]);
+}
+
+TEST_CASE("LOGI arrays pack into bitsets with rank") {
+    /* sizes around the word, the simd register, and the rank table stride */
+    const auto n = GENERATE(0, 1, 7, 63, 64, 65, 511, 512, 513, 2500);
+    auto logis = std::vector< std::int32_t >(n);
+    for (int i = 0; i < n; ++i)
+        logis[i] = (i % 3 == 0 or i % 7 == 0) ? -1 : 0;
+
+    const temporary_file tmp("ecl3-io-logi.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("ACTNUM  ", "LOGI", logis);
+    }
+    ecl3::stream_reader< std::ifstream > fs(path);
+    fs.raw_bodies(GENERATE(true, false));
+
+    ecl3::logi_bitset bits(fs.next());
+    REQUIRE(bits.size() == std::size_t(n));
+
+    std::uint64_t rank = 0;
+    for (int i = 0; i < n; ++i) {
+        if (bits.rank(i) != rank) FAIL("rank mismatch at " << i);
+        if (bits[i] != (logis[i] != 0)) FAIL("bit mismatch at " << i);
+        rank += logis[i] != 0;
+    }
+    CHECK(bits.rank(n) == rank);
+    CHECK(bits.count() == rank);
+    CHECK(ecl3_popcount(bits.words().data(), n) == rank);
+
+    /* the padding bits of the last word are zero */
+    if (n % 64 != 0)
+        CHECK((bits.words().back() >> (n % 64)) == 0);
+
+    /* the same bitset, appended in uneven chunks */
+    ecl3::logi_bitset appended;
+    const std::size_t chunks[] = { 1, 62, 3, 64, 200, 1000 };
+    std::size_t done = 0;
+    for (std::size_t c = 0; done < std::size_t(n); ++c) {
+        const auto k = std::min(chunks[c % 6], std::size_t(n) - done);
+        appended.append(logis.data() + done, k);
+        done += k;
+    }
+    REQUIRE(appended.size() == bits.size());
+    CHECK(appended.words() == bits.words());
+    for (int i = 0; i <= n; ++i)
+        if (appended.rank(i) != bits.rank(i)) FAIL("rank mismatch at " << i);
+}
+
+TEST_CASE("LOGI bitsets are packed from streamed chunks") {
+    const auto n = 4321;
+    auto logis = std::vector< std::int32_t >(n);
+    for (int i = 0; i < n; ++i)
+        logis[i] = (i % 5 == 0 or i % 11 == 0) ? 1 : 0;
+
+    const temporary_file tmp("ecl3-io-logi-chunked.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("ACTNUM  ", "LOGI", logis);
+    }
+    ecl3::stream_reader< std::ifstream > fs(path);
+
+    /* 1000-element blocks, which are not word aligned */
+    ecl3::logi_bitset bits;
+    fs.next_chunked([&bits](const ecl3::raw_array&,
+                            const unsigned char* data,
+                            std::int64_t,
+                            std::int64_t k) {
+        bits.append(data, std::size_t(k));
+    });
+
+    ecl3::logi_bitset expected;
+    expected.assign(logis.data(), logis.size());
+    REQUIRE(bits.size() == std::size_t(n));
+    CHECK(bits.words() == expected.words());
+    CHECK(bits.count() == expected.count());
+    CHECK(bits.rank(2345) == expected.rank(2345));
+}
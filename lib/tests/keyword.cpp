@@ -4,12 +4,18 @@
 #include <cstdio>
 #include <cstring>
 #include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <catch2/catch.hpp>
 #include <endianness/endianness.h>
 
+#include <ecl3/io.hpp>
 #include <ecl3/keyword.h>
 
+#include "files.hpp"
+
 namespace {
 
 template < std::size_t > struct uint_size {};
@@ -545,6 +551,113 @@ TEST_CASE("reading formatted doubles") {
     read_formatted< double >();
 }
 
+template < typename T >
+void read_formatted_inplace() {
+    const auto fmt = type< T >::fmt();
+    /*
+     * The byte swapping is vectorised, so cover sizes that are not multiples
+     * of the register width, and so exercise the scalar tail too
+     */
+    const auto size = GENERATE(range(1, 70));
+    const auto source = GENERATE_COPY(
+        take(1, chunk(size, random(type< T >::min(), type< T >::max())))
+    );
+    auto buffer = type< T >::to_be(source);
+
+    const auto err = ecl3_get_native(buffer.data(), buffer.data(), fmt, size);
+    INFO("fmt = " << ecl3_type_name(fmt) << ", size = " << size);
+    CHECK(err == ECL3_OK);
+    CHECK_THAT(buffer, Equals(source));
+}
+
+TEST_CASE("reading formatted integers in-place") {
+    read_formatted_inplace< std::int32_t >();
+}
+
+TEST_CASE("reading formatted floats in-place") {
+    read_formatted_inplace< float >();
+}
+
+TEST_CASE("reading formatted doubles in-place") {
+    read_formatted_inplace< double >();
+}
+
+template < typename Src, typename Dst >
+void read_converted(int native) {
+    const auto fmt = type< Src >::fmt();
+    const auto size = GENERATE(1, 3, 4, 7, 8, 9, 15, 16, 17, 100, 1000);
+    const auto source = GENERATE_COPY(take(3, chunk(size, random(
+        Src(std::numeric_limits< std::int32_t >::min()),
+        Src(std::numeric_limits< std::int32_t >::max())
+    ))));
+    const auto converted = type< Src >::to_be(source);
+
+    auto expected = std::vector< Dst >(source.size());
+    std::transform(
+        source.begin(),
+        source.end(),
+        expected.begin(),
+        [](Src x) { return static_cast< Dst >(x); }
+    );
+
+    auto result = std::vector< Dst >(source.size());
+    const auto err = ecl3_get_native_as(
+        result.data(),
+        converted.data(),
+        fmt,
+        native,
+        source.size()
+    );
+    INFO("fmt = " << ecl3_type_name(fmt) << ", size = " << size);
+    CHECK(err == ECL3_OK);
+    CHECK_THAT(result, Equals(expected));
+}
+
+TEST_CASE("reading integers as int64") {
+    read_converted< std::int32_t, std::int64_t >(ECL3_NATIVE_INT64);
+}
+
+TEST_CASE("reading integers as float") {
+    read_converted< std::int32_t, float >(ECL3_NATIVE_FLOAT);
+}
+
+TEST_CASE("reading integers as double") {
+    read_converted< std::int32_t, double >(ECL3_NATIVE_DOUBLE);
+}
+
+TEST_CASE("reading floats as double") {
+    read_converted< float, double >(ECL3_NATIVE_DOUBLE);
+}
+
+TEST_CASE("reading doubles as float") {
+    read_converted< double, float >(ECL3_NATIVE_FLOAT);
+}
+
+TEST_CASE("reading integers as int32 with get_native_as") {
+    read_converted< std::int32_t, std::int32_t >(ECL3_NATIVE_INT32);
+}
+
+TEST_CASE("reading floats as float with get_native_as") {
+    read_converted< float, float >(ECL3_NATIVE_FLOAT);
+}
+
+TEST_CASE("reading doubles as double with get_native_as") {
+    read_converted< double, double >(ECL3_NATIVE_DOUBLE);
+}
+
+TEST_CASE("get_native_as rejects unsupported conversions") {
+    const char src[8] = {};
+    double dst;
+    CHECK(ecl3_get_native_as(&dst, src, ECL3_REAL, ECL3_NATIVE_INT32, 1)
+          == ECL3_UNSUPPORTED);
+    CHECK(ecl3_get_native_as(&dst, src, ECL3_CHAR, ECL3_NATIVE_DOUBLE, 1)
+          == ECL3_UNSUPPORTED);
+    CHECK(ecl3_get_native_as(&dst, src, ECL3_INTE, 7132, 1)
+          == ECL3_INVALID_ARGS);
+    CHECK(ecl3_get_native_as(&dst, src, 7132, ECL3_NATIVE_DOUBLE, 1)
+          == ECL3_INVALID_ARGS);
+}
+
 TEST_CASE("invalid format-argument to get_native fails") {
     const auto fmt = GENERATE(
         take(100, filter(not_valid_format, random(-10000, 1000000)))
@@ -645,3 +758,371 @@ TEST_CASE("Read blocked array of DOUB") {
 }
 
 // TODO: add CHAR
+
+TEST_CASE("byte order is detected from big-endian header") {
+    const unsigned char header[] = {
+        0, 0, 0, 16,
+        'I', 'N', 'T', 'E', 'H', 'E', 'A', 'D',
+        0, 0, 0, 2,
+        'I', 'N', 'T', 'E',
+        0, 0, 0, 16,
+    };
+
+    int order;
+    const auto err = ecl3_detect_byteorder(header, &order);
+    CHECK(err == ECL3_OK);
+    CHECK(order == ECL3_BIG_ENDIAN);
+
+    char kw[8];
+    char type[4];
+    int count;
+    ecl3_array_header_from(header + 4, kw, type, &count, order);
+    CHECK(count == 2);
+}
+
+TEST_CASE("byte order is detected from little-endian header") {
+    const unsigned char header[] = {
+        16, 0, 0, 0,
+        'I', 'N', 'T', 'E', 'H', 'E', 'A', 'D',
+        2, 0, 0, 0,
+        'I', 'N', 'T', 'E',
+        16, 0, 0, 0,
+    };
+
+    int order;
+    const auto err = ecl3_detect_byteorder(header, &order);
+    CHECK(err == ECL3_OK);
+    CHECK(order == ECL3_LITTLE_ENDIAN);
+
+    char kw[8];
+    char type[4];
+    int count;
+    ecl3_array_header_from(header + 4, kw, type, &count, order);
+    CHECK(count == 2);
+}
+
+TEST_CASE("byte order detection rejects broken headers") {
+    const unsigned char mismatch[] = {
+        0, 0, 0, 16,
+        'I', 'N', 'T', 'E', 'H', 'E', 'A', 'D',
+        0, 0, 0, 2,
+        'I', 'N', 'T', 'E',
+        16, 0, 0, 0,
+    };
+
+    const unsigned char badtype[] = {
+        0, 0, 0, 16,
+        'I', 'N', 'T', 'E', 'H', 'E', 'A', 'D',
+        0, 0, 0, 2,
+        'F', 'A', 'I', 'L',
+        0, 0, 0, 16,
+    };
+
+    const unsigned char badsize[] = {
+        0, 0, 0, 17,
+        'I', 'N', 'T', 'E', 'H', 'E', 'A', 'D',
+        0, 0, 0, 2,
+        'I', 'N', 'T', 'E',
+        0, 0, 0, 17,
+    };
+
+    int order;
+    CHECK(ecl3_detect_byteorder(mismatch, &order) == ECL3_INVALID_ARGS);
+    CHECK(ecl3_detect_byteorder(badtype, &order)  == ECL3_INVALID_ARGS);
+    CHECK(ecl3_detect_byteorder(badsize, &order)  == ECL3_INVALID_ARGS);
+}
+
+TEST_CASE("reading host-order values is a plain copy") {
+    const auto order = ecl3_native_byteorder();
+    const auto source = std::vector< double >{ 1.0, -2.5, 3.25, 1e-300 };
+    auto result = std::vector< double >(source.size());
+
+    auto err = ecl3_get_native_from(
+        result.data(),
+        source.data(),
+        ECL3_DOUB,
+        source.size(),
+        order
+    );
+    CHECK(err == ECL3_OK);
+    CHECK_THAT(result, Equals(source));
+
+    err = ecl3_get_native_from(
+        result.data(),
+        result.data(),
+        ECL3_DOUB,
+        result.size(),
+        order
+    );
+    CHECK(err == ECL3_OK);
+    CHECK_THAT(result, Equals(source));
+}
+
+TEST_CASE("get_native_from rejects unknown byte orders") {
+    std::int32_t x = 0;
+    CHECK(ecl3_get_native_from(&x, &x, ECL3_INTE, 1, 0) == ECL3_INVALID_ARGS);
+    CHECK(ecl3_get_native_from(&x, &x, ECL3_INTE, 1, 3) == ECL3_INVALID_ARGS);
+}
+
+TEST_CASE("record marker size and byte order are detected") {
+    const unsigned char be4[] = { 0, 0, 0, 16, 'I', 'N', 'T', 'E' };
+    const unsigned char le4[] = { 16, 0, 0, 0, 'I', 'N', 'T', 'E' };
+    const unsigned char be8[] = { 0, 0, 0, 0, 0, 0, 0, 16 };
+    const unsigned char le8[] = { 16, 0, 0, 0, 0, 0, 0, 0 };
+    const unsigned char bad[] = { 0, 0, 0, 24, 'I', 'N', 'T', 'E' };
+
+    int order;
+    int size;
+    CHECK(ecl3_detect_record_marker(be4, &order, &size) == ECL3_OK);
+    CHECK(order == ECL3_BIG_ENDIAN);
+    CHECK(size == 4);
+
+    CHECK(ecl3_detect_record_marker(le4, &order, &size) == ECL3_OK);
+    CHECK(order == ECL3_LITTLE_ENDIAN);
+    CHECK(size == 4);
+
+    CHECK(ecl3_detect_record_marker(be8, &order, &size) == ECL3_OK);
+    CHECK(order == ECL3_BIG_ENDIAN);
+    CHECK(size == 8);
+
+    CHECK(ecl3_detect_record_marker(le8, &order, &size) == ECL3_OK);
+    CHECK(order == ECL3_LITTLE_ENDIAN);
+    CHECK(size == 8);
+
+    CHECK(ecl3_detect_record_marker(bad, &order, &size) == ECL3_INVALID_ARGS);
+}
+
+TEST_CASE("ecl3_scan_arrays indexes a buffer in one call") {
+    const temporary_file tmp("ecl3-keyword-scan-arrays.bin");
+    const auto& path = tmp.path;
+    const auto ints = std::vector< std::int32_t >(2500, 5);
+    const auto doubles = std::vector< double >{ 1.5, -2.25, 1e300 };
+    const auto marker = GENERATE(4, 8);
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    {
+        writer w(path, order, marker);
+        w.array("INTS    ", "INTE", ints);
+        w.array("EMPTY   ", "INTE", std::vector< std::int32_t >{});
+        w.array("DOUBLES ", "DOUB", doubles);
+    }
+    auto bytes = file_bytes(path);
+
+    /* the same offsets stream_reader sees */
+    std::vector< std::uint64_t > offsets;
+    {
+        ecl3::stream_reader< ecl3::buffer_stream > fs(bytes.data(),
+                                                      bytes.size());
+        do offsets.push_back(fs.tell());
+        while (not fs.next_header().empty());
+    }
+    REQUIRE(offsets.size() == 4);
+
+    std::vector< ecl3_array_entry > entries(8);
+    std::size_t count;
+    std::size_t consumed;
+
+    SECTION("all arrays are found") {
+        const auto err = ecl3_scan_arrays(bytes.data(), bytes.size(),
+                                          order, marker,
+                                          entries.data(), entries.size(),
+                                          &count, &consumed);
+        CHECK(err == ECL3_OK);
+        REQUIRE(count == 3);
+        CHECK(consumed == bytes.size());
+
+        CHECK(std::string(entries[0].keyword, 8) == "INTS    ");
+        CHECK(std::string(entries[0].type, 4) == "INTE");
+        CHECK(entries[0].count == 2500);
+        CHECK(entries[1].count == 0);
+        CHECK(entries[1].body_size == 0);
+        CHECK(std::string(entries[2].type, 4) == "DOUB");
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto& e = entries[i];
+            CHECK(std::uint64_t(e.header_offset) == offsets[i]);
+            CHECK(e.body_offset == e.header_offset + 16 + 2 * marker);
+            CHECK(std::uint64_t(e.body_offset + e.body_size) == offsets[i+1]);
+        }
+    }
+
+    SECTION("scanning continues after a full entries array") {
+        auto err = ecl3_scan_arrays(bytes.data(), bytes.size(),
+                                    order, marker,
+                                    entries.data(), 2,
+                                    &count, &consumed);
+        CHECK(err == ECL3_OK);
+        CHECK(count == 2);
+        CHECK(consumed == offsets[2]);
+
+        const auto pos = consumed;
+        err = ecl3_scan_arrays(bytes.data() + pos, bytes.size() - pos,
+                               order, marker,
+                               entries.data(), entries.size(),
+                               &count, &consumed);
+        CHECK(err == ECL3_OK);
+        CHECK(count == 1);
+        CHECK(pos + consumed == bytes.size());
+    }
+
+    SECTION("a buffer that ends inside an array stops before it") {
+        const auto err = ecl3_scan_arrays(bytes.data(), offsets[1] - 100,
+                                          order, marker,
+                                          entries.data(), entries.size(),
+                                          &count, &consumed);
+        CHECK(err == ECL3_OK);
+        CHECK(count == 0);
+        CHECK(consumed == 0);
+
+        ecl3_scan_arrays(bytes.data(), offsets[3] - 1,
+                         order, marker,
+                         entries.data(), entries.size(),
+                         &count, &consumed);
+        CHECK(count == 2);
+        CHECK(consumed == offsets[2]);
+    }
+
+    SECTION("broken block markers are reported") {
+        /* the tail of the second body block */
+        const auto block = 4000 + 2 * marker;
+        const auto tail = offsets[0] + 16 + 2 * marker + 2 * block;
+        bytes[tail - 1] ^= 0x01;
+        const auto err = ecl3_scan_arrays(bytes.data(), bytes.size(),
+                                          order, marker,
+                                          entries.data(), entries.size(),
+                                          &count, &consumed);
+        CHECK(err == ECL3_INVALID_ARGS);
+        CHECK(count == 0);
+    }
+
+    SECTION("invalid marker sizes are rejected") {
+        const auto err = ecl3_scan_arrays(bytes.data(), bytes.size(),
+                                          order, 6,
+                                          entries.data(), entries.size(),
+                                          &count, &consumed);
+        CHECK(err == ECL3_INVALID_ARGS);
+    }
+}
+
+TEST_CASE("ecl3_array_body_ranges decodes scattered bodies in one call") {
+    const temporary_file tmp("ecl3-keyword-body-ranges.bin");
+    const auto& path = tmp.path;
+    auto ints = std::vector< std::int32_t >(2500);
+    for (std::size_t i = 0; i < ints.size(); ++i)
+        ints[i] = std::int32_t(i);
+    const auto marker = GENERATE(4, 8);
+    const auto order = GENERATE(ECL3_BIG_ENDIAN, ECL3_LITTLE_ENDIAN);
+    {
+        writer w(path, order, marker);
+        w.array("INTS    ", "INTE", ints);
+    }
+    auto bytes = file_bytes(path);
+
+    const auto* body = bytes.data() + 16 + 2 * marker;
+    const auto size = bytes.size() - (16 + 2 * marker);
+    const auto block = std::size_t(4000 + 2 * marker);
+
+    auto out = std::vector< std::int32_t >(ints.size());
+    std::int64_t count = -1;
+
+    SECTION("a contiguous body") {
+        const ecl3_body_range range = { body, size };
+        const auto err = ecl3_array_body_ranges(out.data(), &range, 1,
+                                                ECL3_INTE, 2500,
+                                                marker, order, &count);
+        CHECK(err == ECL3_OK);
+        CHECK(count == 2500);
+        CHECK_THAT(out, Equals(ints));
+    }
+
+    SECTION("a body scattered over several ranges") {
+        const ecl3_body_range ranges[] = {
+            { body, block },
+            { body + block, 0 },
+            { body + block, size - block },
+        };
+        const auto err = ecl3_array_body_ranges(out.data(), ranges, 3,
+                                                ECL3_INTE, 2500,
+                                                marker, order, &count);
+        CHECK(err == ECL3_OK);
+        CHECK(count == 2500);
+        CHECK_THAT(out, Equals(ints));
+    }
+
+    SECTION("records split between ranges are rejected") {
+        const ecl3_body_range ranges[] = {
+            { body, block + 10 },
+            { body + block + 10, size - block - 10 },
+        };
+        const auto err = ecl3_array_body_ranges(out.data(), ranges, 2,
+                                                ECL3_INTE, 2500,
+                                                marker, order, &count);
+        CHECK(err == ECL3_INVALID_ARGS);
+        CHECK(count == 0);
+    }
+
+    SECTION("too few or too many elements are rejected") {
+        const ecl3_body_range range = { body, size };
+        auto err = ecl3_array_body_ranges(out.data(), &range, 1,
+                                          ECL3_INTE, 2600,
+                                          marker, order, &count);
+        CHECK(err == ECL3_INVALID_ARGS);
+
+        err = ecl3_array_body_ranges(out.data(), &range, 1,
+                                     ECL3_INTE, 2000,
+                                     marker, order, &count);
+        CHECK(err == ECL3_INVALID_ARGS);
+    }
+
+    SECTION("broken markers leave the output untouched") {
+        bytes[bytes.size() - 1] ^= 0x01;
+        const ecl3_body_range range = { body, size };
+        const auto err = ecl3_array_body_ranges(out.data(), &range, 1,
+                                                ECL3_INTE, 2500,
+                                                marker, order, &count);
+        CHECK(err == ECL3_INVALID_ARGS);
+        CHECK(count == 0);
+        CHECK(std::all_of(out.begin(), out.end(), [](std::int32_t x) {
+            return x == 0;
+        }));
+    }
+}
+
+TEST_CASE("keyword tokens compare keywords as integers") {
+    constexpr ecl3::keyword_token seqhdr = "SEQHDR";
+    static_assert(seqhdr == ecl3::keyword_token("SEQHDR  "), "padding");
+    static_assert(seqhdr != ecl3::keyword_token("MINISTEP"), "");
+
+    CHECK(seqhdr.str() == "SEQHDR  ");
+    CHECK(seqhdr.get() == ecl3_keyword_token("SEQHDR"));
+    CHECK(seqhdr.get() == ecl3_keyword_token("SEQHDR  "));
+    CHECK(ecl3::keyword_token::from_string("SEQHDR") == seqhdr);
+    CHECK_THROWS_AS(ecl3::keyword_token::from_string("TOO-LONG-KW"),
+                    std::invalid_argument);
+
+    /* bytes are packed in keyword order, regardless of host */
+    CHECK(ecl3_keyword_token("A") == 0x2020202020202041ull);
+
+    const temporary_file tmp("ecl3-keyword-tokens.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ECL3_BIG_ENDIAN);
+        w.array("SEQHDR  ", "INTE", std::vector< std::int32_t >{ 1 });
+        w.array("MINISTEP", "INTE", std::vector< std::int32_t >{ 0 });
+    }
+    auto bytes = file_bytes(path);
+
+    ecl3::stream_reader< ecl3::buffer_stream > fs(bytes.data(), bytes.size());
+    CHECK(fs.next().token == seqhdr);
+    CHECK(fs.next().token == ecl3::keyword_token("MINISTEP"));
+
+    std::vector< ecl3_array_entry > entries(2);
+    std::size_t count;
+    std::size_t consumed;
+    ecl3_scan_arrays(bytes.data(), bytes.size(),
+                     ECL3_BIG_ENDIAN, 4,
+                     entries.data(), entries.size(),
+                     &count, &consumed);
+    REQUIRE(count == 2);
+    CHECK(entries[0].token == seqhdr.get());
+    CHECK(entries[1].token == ecl3_keyword_token("MINISTEP"));
+}
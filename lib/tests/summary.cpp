@@ -1,9 +1,16 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <catch2/catch.hpp>
 
+#include <ecl3/smspec.hpp>
 #include <ecl3/summary.h>
 
+#include "files.hpp"
+
 TEST_CASE("manual-listed exceptions don't require type") {
     /*
      * Test the known exceptions, i.e. names that *could* be recognised as
@@ -61,3 +68,188 @@ TEST_CASE("group types require WGNAMES and  nothing else") {
         CHECK(!ecl3_params_identifies(key.c_str(), "GWPR    "));
     }
 }
+
+TEST_CASE("columns are qualified, and void and duplicate columns dropped") {
+    const auto keywords = std::vector< std::string > {
+        "TIME", "WOPR", "WOPR", "FOPT", "WOPR", "COFR", "BPR", "WWCT",
+        "LBPR",
+    };
+    const auto wgnames = std::vector< std::string > {
+        ":+:+:+:+", "OP_1", ":+:+:+:+", "", "OP_1", "OP_2", "", "",
+        ":+:+:+:+",
+    };
+    const auto nums = std::vector< std::int32_t > {
+        0, 0, 0, 0, 0, 12, -1, 0, 0,
+    };
+    const auto lgrs = std::vector< std::string > {
+        "", "", "", "", "", "", "", "", "LGR1",
+    };
+    const auto numlx = std::vector< std::int32_t > {
+        0, 0, 0, 0, 0, 0, 0, 0, 1,
+    };
+    const auto numly = std::vector< std::int32_t > {
+        0, 0, 0, 0, 0, 0, 0, 0, 2,
+    };
+    const auto numlz = std::vector< std::int32_t > {
+        0, 0, 0, 0, 0, 0, 0, 0, 3,
+    };
+
+    const auto cols = ecl3::resolve_columns(
+        keywords, wgnames, nums, lgrs, numlx, numly, numlz, ":"
+    );
+
+    const auto expected = std::vector< std::string > {
+        "TIME", "WOPR:OP_1", "FOPT", "COFR:OP_2:12", "WWCT:",
+        "LBPR:LGR1:1:2:3",
+    };
+    REQUIRE(cols.size() == expected.size());
+    REQUIRE(cols.offsets.size() == expected.size() + 1);
+    for (std::size_t i = 0; i < expected.size(); ++i)
+        CHECK(cols.name(i) == expected[i]);
+
+    const auto pos = std::vector< std::int32_t > { 0, 1, 3, 5, 7, 8 };
+    CHECK(cols.pos == pos);
+
+    const auto none = std::vector< std::int32_t >();
+    const auto missing = std::vector< std::string >();
+    CHECK_THROWS_AS(
+        ecl3::resolve_columns(keywords, missing, nums, missing,
+                              none, none, none, ":"),
+        std::invalid_argument
+    );
+}
+
+TEST_CASE("batch classification agrees with ecl3_params_identifies") {
+    const auto keywords = std::string(
+        "WOPR    "
+        "WMCTL   "
+        "COFR    "
+        "BPR     "
+        "LBPR    "
+        "LCOFR   "
+        "LWOPR   "
+        "NLINEARS"
+        "NFOO    "
+        "SOFR    "
+        "SOIL    "
+        "FOPT    "
+        "TIME    "
+    );
+    const auto n = keywords.size() / 8;
+
+    std::vector< std::uint8_t > masks(n);
+    std::vector< std::uint8_t > counts(n);
+    const auto err = ecl3_params_classify(keywords.data(),
+                                          n,
+                                          masks.data(),
+                                          counts.data());
+    REQUIRE(err == ECL3_OK);
+
+    CHECK(masks[0] == ECL3_PARAMS_WGNAMES);
+    CHECK(counts[0] == 1);
+    CHECK(masks[1] == 0);
+    CHECK(masks[2] == (ECL3_PARAMS_WGNAMES | ECL3_PARAMS_NUMS));
+    CHECK(counts[2] == 2);
+    CHECK(masks[11] == 0);
+    CHECK(counts[11] == 0);
+
+    const int bits[] = {
+        ECL3_PARAMS_WGNAMES,
+        ECL3_PARAMS_NUMS,
+        ECL3_PARAMS_LGRS,
+        ECL3_PARAMS_NUMLX,
+        ECL3_PARAMS_NUMLY,
+        ECL3_PARAMS_NUMLZ,
+    };
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto* kw = keywords.data() + 8 * i;
+        const auto** id = ecl3_params_partial_identifiers();
+        for (int bit : bits) {
+            INFO("keyword = " << std::string(kw, 8) << ", id = " << *id);
+            const auto expected = ecl3_params_identifies(*id++, kw);
+            const auto got = (masks[i] & bit) ? counts[i] : 0;
+            CHECK(got == expected);
+        }
+    }
+
+    CHECK(ecl3_params_classify(nullptr, n, masks.data(), nullptr)
+          == ECL3_INVALID_ARGS);
+}
+
+TEST_CASE("read_smspec parses the specification in one pass") {
+    /*
+     * Strings are never byte swapped, so write the file in the host's byte
+     * order and pass 8-character strings through as 8-byte integers
+     */
+    const auto chars = [](const std::vector< std::string >& xs) {
+        std::vector< std::uint64_t > out(xs.size());
+        for (std::size_t i = 0; i < xs.size(); ++i) {
+            auto s = xs[i];
+            s.resize(8, ' ');
+            std::memcpy(&out[i], s.data(), 8);
+        }
+        return out;
+    };
+
+    const temporary_file tmp("ecl3-summary-smspec.bin");
+    const auto& path = tmp.path;
+    {
+        writer w(path, ecl3_native_byteorder());
+        w.array("DIMENS  ", "INTE",
+                std::vector< std::int32_t >{ 3, 10, 20, 5, 0, -1 });
+        w.array("KEYWORDS", "CHAR", chars({ "TIME", "WOPR", "FOPT" }));
+        w.array("WGNAMES ", "CHAR", chars({ ":+:+:+:+", "OP_1", "FIELD" }));
+        w.array("NUMS    ", "INTE", std::vector< std::int32_t >{ 0, 0, 0 });
+        w.array("UNITS   ", "CHAR", chars({ "DAYS", "SM3/DAY", "SM3" }));
+        w.array("MEASRMNT", "CHAR", chars({
+            "Time", "",
+            "Oil Prod", "uction",
+            "Oil Prod", "uction T",
+        }));
+        w.array("STARTDAT", "INTE",
+                std::vector< std::int32_t >{ 1, 6, 2020 });
+        w.array("UNKNOWN ", "REAL", std::vector< float >{ 1.5f });
+    }
+    const auto bytes = file_bytes(path);
+
+    const auto from_file = ecl3::read_smspec(path);
+    const auto from_buffer = ecl3::read_smspec(bytes.data(), bytes.size());
+
+    for (const auto* spec : { &from_file, &from_buffer }) {
+        CHECK(spec->nlist == 3);
+        CHECK(spec->nx == 10);
+        CHECK(spec->ny == 20);
+        CHECK(spec->nz == 5);
+        CHECK(spec->istar == -1);
+        CHECK(spec->dimens
+           == std::vector< std::int32_t >({ 3, 10, 20, 5, 0, -1 }));
+
+        const auto keywords = std::vector< std::string >{
+            "TIME", "WOPR", "FOPT",
+        };
+        CHECK(spec->keywords == keywords);
+        CHECK(spec->wgnames[1] == "OP_1");
+        CHECK(spec->nums == std::vector< std::int32_t >{ 0, 0, 0 });
+        CHECK(spec->units[1] == "SM3/DAY");
+
+        const auto measurements = std::vector< std::string >{
+            "Time", "Oil Production", "Oil Production T",
+        };
+        CHECK(spec->measurements == measurements);
+        CHECK(spec->startdat == std::vector< std::int32_t >{ 1, 6, 2020 });
+
+        CHECK(spec->has("STARTDAT"));
+        CHECK(not spec->has("LGRS"));
+        CHECK(spec->lgrs.empty());
+
+        REQUIRE(spec->unhandled.size() == 1);
+        CHECK(spec->unhandled[0].token == ecl3::keyword_token("UNKNOWN"));
+    }
+
+    ecl3::smspec spec;
+    ecl3::raw_array measrmnt;
+    measrmnt.keyword = { 'M', 'E', 'A', 'S', 'R', 'M', 'N', 'T' };
+    measrmnt.token = ecl3::keyword_token(measrmnt.keyword);
+    measrmnt.type = { 'C', 'H', 'A', 'R' };
+    CHECK_THROWS_AS(spec.update(measrmnt), std::invalid_argument);
+}
@@ -1,17 +1,24 @@
+#include <algorithm>
 #include <array>
 #include <ciso646>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <string>
 #include <vector>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include <ecl3/keyword.h>
 #include <ecl3/summary.h>
+#include <ecl3/compressed.hpp>
 #include <ecl3/io.hpp>
+#include <ecl3/prefetch.hpp>
+#include <ecl3/smspec.hpp>
+#include <ecl3/typed.hpp>
 
 namespace py = pybind11;
 using namespace py::literals;
@@ -21,175 +28,305 @@ namespace {
 struct array {
     char keyword[9] = {};
     char type[5] = {};
-    int count;
-    py::list values;
+    std::int64_t count;
+    py::array values;
 };
 
-struct stream : std::ifstream {
-    stream(const std::string& path) :
-        std::ifstream(path, std::ios::binary | std::ios::in)
-    {
-        if (!this->is_open()) {
-            const auto msg = "could not open file '" + path + "'";
-            throw std::invalid_argument(msg);
-        }
+/*
+ * The readers are different types depending on the source, so put them
+ * behind an interface to make core.stream work with all of them
+ */
+struct source {
+    virtual ~source() = default;
+    virtual const ecl3::raw_array& next() = 0;
+    virtual void select(const std::vector< std::string >& kws) = 0;
+    virtual void raw_bodies(bool enable) = 0;
+    virtual int byteorder() const = 0;
+};
 
-        auto errors = std::ios::failbit | std::ios::badbit | std::ios::eofbit;
-        this->exceptions(errors);
+template < typename Stream >
+struct reader_source : public source {
+    template < typename... Args >
+    explicit reader_source(Args&&... args) :
+        reader(std::forward< Args >(args)...)
+    {}
+
+    const ecl3::raw_array& next() override {
+        return this->reader.next();
     }
 
-    std::vector< array > keywords();
+    void select(const std::vector< std::string >& kws) override {
+        this->reader.select(kws);
+    }
 
-};
+    void raw_bodies(bool enable) override {
+        this->reader.raw_bodies(enable);
+    }
 
-array getheader(std::ifstream& fs) {
-    array a;
-    char buffer[16];
-    fs.read(buffer, sizeof(buffer));
+    int byteorder() const override {
+        return this->reader.byteorder();
+    }
 
-    auto err = ecl3_array_header(buffer, a.keyword, a.type, &a.count);
+    ecl3::stream_reader< Stream > reader;
+};
 
-    if (err) {
-        auto msg = std::string("invalid argument to ecl3_array_header: ");
-        msg.insert(msg.end(), buffer, buffer + sizeof(buffer));
-        throw std::invalid_argument(msg);
+/*
+ * A contiguous, read-only view of an object that supports the buffer
+ * protocol, like bytes and memoryview. The object is kept alive, and can't
+ * be resized, until the view is released.
+ */
+struct buffer_view {
+    explicit buffer_view(py::object obj) {
+        if (PyObject_GetBuffer(obj.ptr(), &this->view, PyBUF_SIMPLE) != 0)
+            throw py::error_already_set();
     }
 
-    return a;
-}
+    ~buffer_view() { PyBuffer_Release(&this->view); }
 
-template < typename T >
-void extend(py::list& l, const char* src, int n, T tmp) {
-    for (int i = 0; i < n; ++i) {
-        std::memcpy(&tmp, src + (i * sizeof(T)), sizeof(T));
-        l.append(tmp);
-    }
+    buffer_view(const buffer_view&) = delete;
+    buffer_view& operator=(const buffer_view&) = delete;
+
+    Py_buffer view;
+};
+
+/*
+ * bytes are read as the contents of a file, never as a path. A bytes path,
+ * e.g. b'/x/CASE.SMSPEC', would otherwise fail with an opaque header error,
+ * so reject bytes that can't be a file up front. Every file starts with the
+ * 4- or 8-byte record marker of a 16-byte header, and no path does.
+ */
+void check_contents(const py::object& src, const buffer_view& buffer) {
+    if (not py::isinstance< py::bytes >(src)) return;
+
+    const auto len = buffer.view.len;
+    const auto* p = static_cast< const unsigned char* >(buffer.view.buf);
+    /* 16 as a 4-byte marker in either byte order, or an 8-byte marker */
+    const auto marker = len >= 4 and p[1] == 0 and p[2] == 0 and (
+        (p[0] == 0  and (p[3] == 16 or p[3] == 0)) or
+        (p[0] == 16 and p[3] == 0)
+    );
+    if (len == 0 or marker) return;
+
+    const auto msg = "bytes are read as file contents, not as a path, "
+                     "and do not start with a record marker. "
+                     "Pass paths as str or os.PathLike, e.g. os.fsdecode(path)";
+    throw std::invalid_argument(msg);
 }
 
-void extend_char(py::list& l, const char* src, int n) {
-    char tmp[8];
-    for (int i = 0; i < n; ++i) {
-        std::memcpy(tmp, src + (i * sizeof(tmp)), sizeof(tmp));
-        l.append(py::str(tmp, sizeof(tmp)));
+struct stream {
+    explicit stream(py::object src);
+
+    std::vector< array > keywords();
+
+    /*
+     * For in-memory sources, the reader reads straight from the buffer, so
+     * buffer must outlive reader, i.e. be declared before it
+     */
+    std::unique_ptr< buffer_view > buffer;
+    std::unique_ptr< source > reader;
+};
+
+/*
+ * Files are opened by path, and may be compressed. Objects that export the
+ * buffer protocol, e.g. bytes and memoryview, and io.BytesIO (through
+ * getbuffer()), are read in-place without copying. bytes are always contents,
+ * see check_contents.
+ */
+stream::stream(py::object src) {
+    if (py::isinstance< py::str >(src) or py::hasattr(src, "__fspath__")) {
+        const auto fspath = py::module::import("os").attr("fspath");
+        const auto path = py::str(fspath(src)).cast< std::string >();
+        using reader = reader_source< ecl3::compressed_stream >;
+        this->reader.reset(new reader(path));
+        return;
     }
+
+    if (py::hasattr(src, "getbuffer"))
+        src = src.attr("getbuffer")();
+
+    this->buffer.reset(new buffer_view(src));
+    check_contents(src, *this->buffer);
+    const auto* data = this->buffer->view.buf;
+    const auto size = std::size_t(this->buffer->view.len);
+    using reader = reader_source< ecl3::buffer_stream >;
+    this->reader.reset(new reader(data, size));
 }
 
-void extend(py::list& l, const char* src, ecl3_typeids type, int count) {
+/*
+ * Decode count elements of type from src, in byte order order, into a new
+ * numpy array. The storage is allocated here, and handed to numpy through a
+ * capsule that frees it, so the elements are byte swapped straight into the
+ * array, and never copied afterwards. CHAR and C0NN arrays are fixed-width
+ * byte strings, i.e. S8 and SNN.
+ */
+py::array to_numpy(int type,
+                   const void* src,
+                   std::int64_t count,
+                   int order) {
+    std::string format;
     switch (type) {
-        case ECL3_INTE:
-            extend(l, src, count, std::int32_t(0));
-            break;
+        case ECL3_INTE: format = "i4"; break;
+        case ECL3_REAL: format = "f4"; break;
+        case ECL3_DOUB: format = "f8"; break;
+        case ECL3_LOGI: format = "?";  break;
+        case ECL3_CHAR: format = "S8"; break;
 
-        case ECL3_REAL:
-            extend(l, src, count, float(0));
-            break;
-
-        case ECL3_DOUB:
-            extend(l, src, count, double(0));
-            break;
+        default:
+            if (not ecl3::is_c0nn_type(type))
+                throw std::invalid_argument("unknown type");
+            format = "S" + std::to_string(ecl3::c0nn_digits(type));
+    }
 
-        case ECL3_CHAR:
-            extend_char(l, src, count);
-            break;
+    const auto dtype = py::dtype::from_args(py::str(format));
+    const auto n = std::size_t(count);
+    const auto itemsize = std::size_t(dtype.itemsize());
+    std::unique_ptr< unsigned char[] > buf(new unsigned char[n * itemsize]);
 
-        default:
-            throw std::invalid_argument("unknown type");
+    if (type == ECL3_LOGI) {
+        static_assert(sizeof(bool) == 1, "numpy bools are 1 byte");
+        ecl3::decode(reinterpret_cast< bool* >(buf.get()), src, n, order);
+    } else if (ecl3_get_native_from(buf.get(), src, type, n, order)) {
+        throw std::invalid_argument("invalid byte order");
     }
+
+    auto* data = buf.get();
+    const auto owner = py::capsule(data, [](void* p) {
+        delete[] static_cast< unsigned char* >(p);
+    });
+    buf.release();
+
+    return py::array(
+        dtype,
+        std::vector< std::size_t >{ n },
+        std::vector< std::size_t >{ itemsize },
+        data,
+        owner
+    );
 }
 
 std::vector< array > stream::keywords() {
     std::vector< array > kws;
 
-    std::array< char, sizeof(std::int32_t) > head;
-    std::array< char, sizeof(std::int32_t) > tail;
-
-    auto buffer = std::vector< char >();
-
-    std::int32_t ix;
-    float fx;
-    double dx;
-    char str[9] = "        ";
+    /*
+     * Decode the on-disk bodies directly into the numpy arrays, rather than
+     * decoding them in the reader, and copying
+     */
+    this->reader->raw_bodies(true);
 
     while (true) {
-        try {
-            this->read(head.data(), sizeof(head));
-        } catch (std::ios::failure&) {
-            if (this->eof()) return kws;
-            /* some error is set - propagate exception */
-        }
-        auto kw = getheader(*this);
-        this->read(tail.data(), sizeof(tail));
-        if (head != tail) {
-            std::int32_t h;
-            std::int32_t t;
-            ecl3_get_native(&h, head.data(), ECL3_INTE, 1);
-            ecl3_get_native(&t, tail.data(), ECL3_INTE, 1);
+        const auto& x = this->reader->next();
+        if (x.empty()) return kws;
 
-            std::stringstream ss;
-            ss << "array header: "
-               << "head (" << h << ")"
-               << " != tail (" << t << ")"
-            ;
-
-            throw std::runtime_error(ss.str());
-        }
+        array kw;
+        std::copy(x.keyword.begin(), x.keyword.end(), kw.keyword);
+        std::copy(x.type.begin(), x.type.end(), kw.type);
+        kw.count = x.count;
 
-        int err;
         int type;
-        int size;
-        int blocksize;
-        err = ecl3_typeid(kw.type, &type);
+        const auto err = ecl3_typeid(kw.type, &type);
         if (err) {
             auto msg = std::string("unknown type: '");
             msg += kw.type;
             msg += "'";
             throw std::invalid_argument(msg);
         }
-        ecl3_type_size(type, &size);
-        ecl3_block_size(type, &blocksize);
-        int remaining = kw.count;
-
-        while (remaining > 0) {
-            this->read(head.data(), sizeof(head));
-            std::int32_t elems;
-            ecl3_get_native(&elems, head.data(), ECL3_INTE, 1);
-
-            buffer.resize(elems);
-            this->read(buffer.data(), elems);
-
-            this->read(tail.data(), sizeof(tail));
-            if (head != tail) {
-                std::int32_t h;
-                std::int32_t t;
-                ecl3_get_native(&h, head.data(), ECL3_INTE, 1);
-                ecl3_get_native(&t, tail.data(), ECL3_INTE, 1);
-
-                std::stringstream ss;
-                ss << "array body: "
-                   << "head (" << h << ")"
-                   << " != tail (" << t << ")"
-                ;
-
-                throw std::runtime_error(ss.str());
-            }
-
-            int count;
-            ecl3_array_body(
-                buffer.data(),
-                buffer.data(),
-                type,
-                remaining,
-                blocksize,
-                &count
-            );
-            remaining -= count;
-            extend(kw.values, buffer.data(), ecl3_typeids(type), count);
-        }
 
+        const auto order = this->reader->byteorder();
+        kw.values = to_numpy(type, x.body.data(), kw.count, order);
         kws.push_back(kw);
     }
+}
 
-    return kws;
+template < typename T >
+py::object field(const ecl3::smspec& spec,
+                 ecl3::keyword_token kw,
+                 const T& x) {
+    if (not spec.has(kw)) return py::none();
+    return py::cast(x);
+}
+
+/*
+ * Parse the summary specification in C++, in one pass, and hand it over as a
+ * dict of the summary attributes. Attributes for keywords not in the file are
+ * None. The keywords that need interpretation in python (INTEHEAD, STARTDAT,
+ * RUNTIMEI, ...) and unknown keywords are passed as (keyword, values) pairs
+ * in 'update', in file order.
+ */
+py::dict smspec(py::object src) {
+    ecl3::smspec spec;
+    if (py::isinstance< py::str >(src) or py::hasattr(src, "__fspath__")) {
+        const auto fspath = py::module::import("os").attr("fspath");
+        const auto path = py::str(fspath(src)).cast< std::string >();
+        spec = ecl3::read_smspec(path);
+    } else {
+        if (py::hasattr(src, "getbuffer"))
+            src = src.attr("getbuffer")();
+
+        const buffer_view buffer(src);
+        check_contents(src, buffer);
+        const auto size = std::size_t(buffer.view.len);
+        spec = ecl3::read_smspec(buffer.view.buf, size);
+    }
+
+    py::dict d;
+    const auto dimens = spec.has("DIMENS");
+    d["nlist"] = dimens ? py::cast(spec.nlist) : py::none();
+    d["istar"] = dimens ? py::cast(spec.istar) : py::none();
+    d["gridshape"] = dimens
+        ? py::object(py::make_tuple(spec.nx, spec.ny, spec.nz))
+        : py::none()
+    ;
+
+    d["dimens"]       = field(spec, "DIMENS",   spec.dimens);
+    d["restart"]      = field(spec, "RESTART",  spec.restart);
+    d["keywords"]     = field(spec, "KEYWORDS", spec.keywords);
+    d["wgnames"]      = field(spec, "WGNAMES",  spec.wgnames);
+    d["names"]        = field(spec, "NAMES",    spec.names);
+    d["nums"]         = field(spec, "NUMS",     spec.nums);
+    d["lgrs"]         = field(spec, "LGRS",     spec.lgrs);
+    d["numlx"]        = field(spec, "NUMLX",    spec.numlx);
+    d["numly"]        = field(spec, "NUMLY",    spec.numly);
+    d["numlz"]        = field(spec, "NUMLZ",    spec.numlz);
+    d["lengths"]      = field(spec, "LENGTHS",  spec.lengths);
+    d["lenunits"]     = field(spec, "LENUNITS", spec.lenunits);
+    d["measurements"] = field(spec, "MEASRMNT", spec.measurements);
+    d["units"]        = field(spec, "UNITS",    spec.units);
+    d["lgrnames"]     = field(spec, "LGRNAMES", spec.lgrnames);
+    d["lgrvec"]       = field(spec, "LGRVEC",   spec.lgrvec);
+    d["lgrtimes"]     = field(spec, "LGRTIMES", spec.lgrtimes);
+    d["step_reason"]  = field(spec, "STEPRESN", spec.step_reason);
+    d["xcoord"]       = field(spec, "XCOORD",   spec.xcoord);
+    d["ycoord"]       = field(spec, "YCOORD",   spec.ycoord);
+
+    py::list present;
+    for (const auto& kw : spec.present)
+        present.append(py::str(kw.str()));
+    d["present"] = present;
+
+    py::list update;
+    const auto small = [&](const char* kw, py::object values) {
+        if (spec.has(ecl3::keyword_token::from_string(kw)))
+            update.append(py::make_tuple(kw, values));
+    };
+    small("INTEHEAD", py::cast(spec.intehead));
+    small("STARTDAT", py::cast(spec.startdat));
+    small("RUNTIMEI", py::cast(spec.runtimei));
+    small("RUNTIMED", py::cast(spec.runtimed));
+    small("TIMESTMP", py::cast(spec.timestamp));
+
+    for (const auto& x : spec.unhandled) {
+        const auto type = std::string(x.type.begin(), x.type.end());
+        int typeid_;
+        if (ecl3_typeid(type.c_str(), &typeid_))
+            throw std::invalid_argument("unknown type: '" + type + "'");
+
+        const auto order = ecl3_native_byteorder();
+        const auto values = to_numpy(typeid_, x.body.data(), x.count, order);
+        update.append(py::make_tuple(py::str(x.token.str()), values));
+    }
+    d["update"] = update;
+
+    return d;
 }
 
 py::list spec_keywords() {
@@ -200,109 +337,39 @@ py::list spec_keywords() {
     return xs;
 }
 
-bool is_void(const std::string& str) noexcept (true) {
-    return str == ":+:+:+:+" or str == "        ";
-}
-
-bool is_void(std::int32_t i) noexcept (true) {
-    return i < 0;
-}
-
 py::tuple columns(
-    py::list keywords,
-    py::list wgnames,
-    py::list nums,
-    py::list lgrs,
-    py::list numlx,
-    py::list numly,
-    py::list numlz,
+    const std::vector< std::string >& keywords,
+    const std::vector< std::string >& wgnames,
+    const std::vector< std::int32_t >& nums,
+    const std::vector< std::string >& lgrs,
+    const std::vector< std::int32_t >& numlx,
+    const std::vector< std::int32_t >& numly,
+    const std::vector< std::int32_t >& numlz,
     const std::string& dtype_separator)
 {
     /*
-     * Figure out the fully qualified column names for a summary file.
-     *
-     * See the docs for ecl3_params_identifies for more details. In short, a
-     * lot of data types are well or cell specific, and the keyword alone is
-     * not enough to read anything meaningful out of the corresponding vector.
-     * Determine these names by scanning through keywords, wgnames, nums etc.
-     *
-     * Sometimes, invalid or known void entries are used to signal that a
-     * column is filled with garbage, most commonly :+:+:+:+, and these columns
-     * are discarded.
+     * Figure out the fully qualified column names for a summary file. See
+     * ecl3::resolve_columns for details.
      */
-    assert(!keywords.empty());
-    assert(!wgnames.empty());
-    assert(!nums.empty());
-
-    assert(keywords.size() == wgnames.size());
-    assert(keywords.size() == nums.size());
-
-    assert(lgrs.empty()  or keywords.size() == lgrs.size());
-    assert(numlx.empty() or keywords.size() == numlx.size());
-    assert(numly.empty() or keywords.size() == numly.size());
-    assert(numlz.empty() or keywords.size() == numlz.size());
-
-    static constexpr const auto WGNAMES = "WGNAMES ";
-    static constexpr const auto NUMS    = "NUMS    ";
-    static constexpr const auto LGRS    = "LGRS    ";
-    static constexpr const auto NUMLX   = "NUMLX   ";
-    static constexpr const auto NUMLY   = "NUMLY   ";
-    static constexpr const auto NUMLZ   = "NUMLZ   ";
-
-    auto names = std::vector< std::string >();
-    auto pos = std::vector< int >();
-
-    for (std::size_t i = 0; i < keywords.size(); ++i) {
-        const auto kw = keywords[i].cast< std::string >();
-
-        std::stringstream id;
-        id << kw;
-        if (ecl3_params_identifies(WGNAMES, kw.c_str())) {
-            const auto wgname = wgnames[i].cast< std::string >();
-            if (is_void(wgname)) continue;
-            id << dtype_separator << wgname;
-        }
-
-        if (ecl3_params_identifies(NUMS, kw.c_str())) {
-            const auto num = nums[i].cast< std::int32_t >();
-            if (is_void(num)) continue;
-            id << dtype_separator << num;
-        }
-
-        if (not lgrs.empty() and ecl3_params_identifies(LGRS, kw.c_str())) {
-            const auto lgr = lgrs[i].cast< std::string >();
-            if (is_void(lgr)) continue;
-            id << dtype_separator << lgr;
-        }
-
-        if (not numlx.empty() and ecl3_params_identifies(NUMLX, kw.c_str())) {
-            const auto nx = numlx[i].cast< std::int32_t >();
-            if (is_void(nx)) continue;
-            id << dtype_separator << nx;
-        }
-
-        if (not numly.empty() and ecl3_params_identifies(NUMLY, kw.c_str())) {
-            const auto ny = numly[i].cast< std::int32_t >();
-            if (is_void(ny)) continue;
-            id << dtype_separator << ny;
-        }
-
-        if (not numlz.empty() and ecl3_params_identifies(NUMLZ, kw.c_str())) {
-            const auto nz = numlz[i].cast< std::int32_t >();
-            if (is_void(nz)) continue;
-            id << dtype_separator << nz;
-        }
-
-        const auto name = id.str();
-        // skip if this is a duplicate somehow
-        if (std::find(names.begin(), names.end(), name) != names.end())
-            continue;
-
-        names.push_back(name);
-        pos.push_back(int(i));
+    const auto cols = ecl3::resolve_columns(
+        keywords,
+        wgnames,
+        nums,
+        lgrs,
+        numlx,
+        numly,
+        numlz,
+        dtype_separator
+    );
+
+    py::list names;
+    for (std::size_t i = 0; i < cols.size(); ++i) {
+        const auto* begin = cols.chars.data() + cols.offsets[i];
+        const auto len = cols.offsets[i + 1] - cols.offsets[i];
+        names.append(py::str(begin, len));
     }
 
-    return py::make_tuple(names, pos);
+    return py::make_tuple(names, cols.pos);
 }
 
 template < unsigned long Len >
@@ -316,20 +383,86 @@ void expect(const std::string& expected, const std::array< char, Len >& str) {
     }
 }
 
+void expect(ecl3::keyword_token expected, const ecl3::raw_array& x) {
+    if (x.token != expected) {
+        const auto stdstr = std::string(x.keyword.data(), x.keyword.size());
+        const auto msg = "expected " + expected.str() + ", was " + stdstr;
+        throw std::runtime_error(msg);
+    }
+}
+
+constexpr ecl3::keyword_token SEQHDR   = "SEQHDR";
+constexpr ecl3::keyword_token MINISTEP = "MINISTEP";
+constexpr ecl3::keyword_token PARAMS   = "PARAMS";
+
 bool end_report_step(const ecl3::raw_array& kw) noexcept (true) {
-    return std::equal(kw.keyword.begin(), kw.keyword.end(), "SEQHDR  ");
+    return kw.token == SEQHDR;
 }
 
+/*
+ * The size of an array on disk, header and body, record markers included
+ */
+std::uint64_t array_size(const ecl3::raw_array& x, int marker) {
+    int type;
+    if (ecl3_typeid(x.type.data(), &type)) {
+        const auto t = std::string(x.type.begin(), x.type.end());
+        throw std::invalid_argument("unknown type: '" + t + "'");
+    }
+
+    const auto header = 16 + 2 * std::uint64_t(marker);
+    return header + ecl3::body_size(type, x.count, marker);
+}
+
+/*
+ * The storage of the rows array, which must be exactly rows * rowsize bytes.
+ * The pointer is valid for as long as the array is alive.
+ */
+unsigned char* storage(py::buffer& arr, std::size_t rows, int rowsize) {
+    const auto view = arr.request(true);
+    const auto size = std::size_t(view.size) * std::size_t(view.itemsize);
+    const auto expected = rows * std::size_t(rowsize);
+    if (size != expected) {
+        std::stringstream msg;
+        msg << "internal alloc function size error, was "
+            << size
+            << " (" << view.size << " rows)"
+            << ", expected "
+            << expected
+            << " (" << rows << " rows)"
+        ;
+        throw std::invalid_argument(msg.str());
+    }
+
+    return static_cast< unsigned char* >(view.ptr);
+}
+
+template < typename Reader >
 py::object readall(
-    const std::string& fname,
+    Reader& stream,
     py::object alloc,
     int rowsize,
-    const std::vector< int >& pos) {
+    const std::vector< int >& pos,
+    int itemsize,
+    std::uint64_t file_size) {
+
+    int native;
+    switch (itemsize) {
+        case 4: native = ECL3_NATIVE_FLOAT;  break;
+        case 8: native = ECL3_NATIVE_DOUBLE; break;
+        default: {
+            std::stringstream msg;
+            msg << "expected column itemsize 4 or 8, was " << itemsize;
+            throw std::invalid_argument(msg.str());
+        }
+    }
 
-    int rows = 0;
+    std::size_t rows = 0;
     std::int32_t report_step = 1;
-    ecl3::stream_reader< std::ifstream > stream(fname);
-    auto buffer = std::vector< unsigned char >(64 * rowsize);
+    /*
+     * The PARAMS are converted straight from their on-disk representation
+     * into the output precision, so don't decode bodies in the reader
+     */
+    stream.raw_bodies(true);
 
     const auto& seqhdr = stream.next();
     if (seqhdr.empty()) {
@@ -338,14 +471,38 @@ py::object readall(
         throw std::runtime_error(msg);
     }
 
-    expect("SEQHDR  ", seqhdr.keyword);
+    expect(SEQHDR, seqhdr);
     expect("INTE", seqhdr.type);
 
-    while (true) {
-        if ((rows + 1) * rowsize >= buffer.size()) {
-            buffer.resize(buffer.size() * 2);
-        }
+    /*
+     * Every row is a MINISTEP-PARAMS pair of the same size on disk, so the
+     * file size bounds the number of rows. Allocate the result up front,
+     * and decode straight into it. For uncompressed files the bound is
+     * exact for a single report step, and only a few rows too large
+     * otherwise, since SEQHDR is tiny compared to PARAMS. Compressed files
+     * are larger than their size on disk, and the array grows as needed.
+     *
+     * The array is never resized in-place, as numpy can only do that safely
+     * when nothing else references it. It grows by copying the rows into a
+     * new, larger array, and if it ends up too large, a slice of it is
+     * returned when the slack is small, and an exact copy otherwise.
+     */
+    const auto marker = stream.record_marker_size();
+    const auto seqhdr_size = array_size(seqhdr, marker);
+    std::uint64_t row_size = 0;
+    if (not stream.peek(0).empty())
+        row_size += array_size(stream.peek(0), marker);
+    if (not stream.peek(1).empty())
+        row_size += array_size(stream.peek(1), marker);
+
+    std::size_t capacity = 0;
+    if (row_size > 0 and file_size > seqhdr_size)
+        capacity = std::size_t((file_size - seqhdr_size) / row_size);
 
+    py::buffer arr = alloc(capacity);
+    auto* buffer = storage(arr, capacity, rowsize);
+
+    while (true) {
         const auto& ministep = stream.next();
         if (ministep.empty()) {
             // if this is empty, we're at an acceptable place for an eof
@@ -355,24 +512,36 @@ py::object readall(
         }
 
         if (end_report_step(ministep)) {
-            // read the next record, which now should not be empty (it should
-            // be MINISTEP), then unget so the next iteration's MINISTEP gets
-            // this record
-            if (stream.next().empty()) {
+            // the next record should not be empty (it should be MINISTEP),
+            // and it's read by the next iteration
+            if (stream.peek().empty()) {
                 const auto msg = "unexpected end-of-file, expected MINISTEP";
                 throw std::runtime_error(msg);
             }
 
-            stream.unget();
             continue;
         }
 
-        expect("MINISTEP", ministep.keyword);
+        expect(MINISTEP, ministep);
         expect("INTE", ministep.type);
 
-        auto* dst = buffer.data() + rows * rowsize;
-        std::memcpy(dst += 0, &report_step, sizeof(report_step));
-        std::memcpy(dst += 4, ministep.body.data(), sizeof(std::int32_t));
+        if (rows == capacity) {
+            capacity = std::max(capacity * 2, std::size_t(64));
+            py::buffer larger = alloc(capacity);
+            auto* dst = storage(larger, capacity, rowsize);
+            if (rows > 0)
+                std::memcpy(dst, buffer, rows * std::size_t(rowsize));
+            arr = std::move(larger);
+            buffer = dst;
+        }
+
+        auto* dst = buffer + rows * std::size_t(rowsize);
+        std::memcpy(dst, &report_step, sizeof(report_step));
+        const auto order = stream.byteorder();
+        std::int32_t step;
+        ecl3::decode(&step, ministep.body.data(), 1, order);
+        std::memcpy(dst + 4, &step, sizeof(step));
+        dst += 8;
 
         // this invalidates all references to ministep
         const auto& params = stream.next();
@@ -380,44 +549,94 @@ py::object readall(
             const auto msg = "unexpected end-of-file, expected PARAMS";
             throw std::runtime_error(msg);
         }
-        expect("PARAMS  ", params.keyword);
+        expect(PARAMS, params);
+        expect("REAL", params.type);
         const auto* src = params.body.data();
         // write_item
-        for (auto p : pos) {
-            static_assert(
-                sizeof(float) == 4,
-                "the pointer arithmetic relies on 4-byte float"
+        std::size_t i = 0;
+        while (i < pos.size()) {
+            /*
+             * Columns are mostly contiguous, with the occasional discarded
+             * column. Convert runs of consecutive columns in one call
+             */
+            std::size_t n = 1;
+            while (i + n < pos.size() and pos[i + n] == pos[i] + int(n))
+                ++n;
+
+            using real = ecl3::type_traits< ECL3_REAL >;
+            const auto src_off = pos[i] * sizeof(real::disk_type);
+            ecl3_get_native_as_from(
+                dst,
+                src + src_off,
+                real::id,
+                native,
+                n,
+                order
             );
-            const auto src_off = p * sizeof(float);
-            std::memcpy(dst += 4, src + src_off, sizeof(float));
+            dst += n * itemsize;
+            i += n;
         }
 
         ++rows;
     }
 
-    py::buffer arr = alloc(rows);
-    auto view = arr.request(true);
-    if (view.size * view.itemsize != rowsize * rows) {
+    if (rows == capacity)
+        return arr;
+
+    /* a few rows of slack is cheaper to keep than to copy the report */
+    const py::object view = arr[py::slice(0, Py_ssize_t(rows), 1)];
+    if (capacity - rows <= rows / 8)
+        return view;
+
+    return view.attr("copy")();
+}
+
+/*
+ * With readahead > 0, the file is read by a background thread, readahead
+ * blocks ahead of the decoding.
+ *
+ * alloc(rows) must return a new numpy array of rows rows of rowsize bytes.
+ * It may be called more than once, when the rows don't fit.
+ */
+py::object readall(
+    const std::string& fname,
+    py::object alloc,
+    int rowsize,
+    const std::vector< int >& pos,
+    int itemsize,
+    int readahead) {
+
+    if (readahead < 0) {
         std::stringstream msg;
-        msg << "internal alloc function size error, was "
-            << view.size * view.itemsize
-            << " (" << view.size << " rows)"
-            << ", expected "
-            << rowsize * rows
-            << " (" << rows << " rows)"
-        ;
+        msg << "expected readahead >= 0, was " << readahead;
         throw std::invalid_argument(msg.str());
     }
-    std::memcpy(view.ptr, buffer.data(), rows * rowsize);
-    return arr;
+
+    /* the size on disk, which bounds the rows of uncompressed files */
+    std::ifstream fs(fname, std::ios::binary | std::ios::ate);
+    const auto end = fs.tellg();
+    const auto size = end < 0 ? std::uint64_t(0) : std::uint64_t(end);
+    fs.close();
+
+    if (readahead == 0) {
+        ecl3::stream_reader< ecl3::compressed_stream > stream(fname);
+        return readall(stream, alloc, rowsize, pos, itemsize, size);
+    }
+
+    using prefetch = ecl3::prefetch_stream< ecl3::compressed_stream >;
+    ecl3::stream_reader< prefetch > stream(fname, std::size_t(readahead));
+    return readall(stream, alloc, rowsize, pos, itemsize, size);
 }
 
 }
 
 PYBIND11_MODULE(core, m) {
     py::class_<stream>(m, "stream")
-        .def(py::init<const std::string&>())
+        .def(py::init<py::object>())
         .def("keywords", &stream::keywords)
+        .def("select", [](stream& self, const std::vector< std::string >& kws) {
+            self.reader->select(kws);
+        })
     ;
 
     py::class_<array>(m, "array")
@@ -427,13 +646,9 @@ PYBIND11_MODULE(core, m) {
             auto kw = std::string(x.keyword);
             auto type = std::string(x.type);
 
-            ss << "{ " << kw << ", " << type << ": [ ";
-
-            for (const auto& val : x.values) {
-                ss << py::str(val).cast< std::string >() << " ";
-            }
-
-            ss << "] }";
+            ss << "{ " << kw << ", " << type << ": "
+               << py::repr(x.values).cast< std::string >()
+               << " }";
             return ss.str();
         })
         .def_readonly("keyword", &array::keyword)
@@ -441,8 +656,24 @@ PYBIND11_MODULE(core, m) {
     ;
 
     m.def("spec_keywords", spec_keywords);
+    m.def("smspec", smspec);
     m.def("unitsystem",  ecl3_unit_system_name);
     m.def("simulatorid", ecl3_simulatorid_name);
     m.def("columns", columns);
-    m.def("readall", readall);
+    m.def("readall",
+        static_cast< py::object (*)(
+            const std::string&,
+            py::object,
+            int,
+            const std::vector< int >&,
+            int,
+            int
+        ) >(readall),
+        "fname"_a,
+        "alloc"_a,
+        "rowsize"_a,
+        "pos"_a,
+        "itemsize"_a,
+        "readahead"_a = 0
+    );
 }
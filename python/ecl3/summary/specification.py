@@ -17,6 +17,20 @@ def timestamp(xs):
         second  = xs[5],
     )
 
+def strings(values):
+    """Values as a list of python objects, with byte strings decoded
+
+    core.stream.keywords returns numpy arrays, and CHAR arrays as fixed-width
+    byte strings, but update works on lists of str and int.
+    """
+    if isinstance(values, np.ndarray):
+        values = values.tolist()
+
+    return [
+        x.decode('ascii') if isinstance(x, bytes) else x
+        for x in values
+    ]
+
 class runtime_monitor(object):
     def __init__(self):
         self.finished = None
@@ -109,6 +123,7 @@ class summary(object):
             self.update(key, value)
 
         self.dtype_separator = '.'
+        self.column_type = 'f4'
 
     @property
     def dtype(self):
@@ -124,6 +139,10 @@ class summary(object):
 
         Notes
         -----
+        The columns are of column_type, which is 'f4' by default. Values are
+        stored as 'f4' on disk, but setting column_type to 'f8' makes readall
+        output double precision without an extra conversion pass.
+
         This function is not likely to be useful to an end user, who should
         instead use functions like readall.
 
@@ -151,11 +170,11 @@ class summary(object):
         names, pos = core.columns(kw, wg, nu, lg, nx, ny, nz, sep)
 
         self.pos = pos
-        columns = [(name, 'f4') for name in names]
+        columns = [(name, self.column_type) for name in names]
         index = [('REPORTSTEP', 'i4'), ('MINISTEP', 'i4')]
         return np.dtype(index + columns)
 
-    def readall(self, f):
+    def readall(self, f, readahead = 0):
         """Read full summary report
 
         Eagerly read the full summary report into a numpy array. The input
@@ -165,12 +184,21 @@ class summary(object):
         Parameters
         ----------
         f : str_like
-            filename
+            filename, which may be gzip or zstd compressed
+        readahead : int, optional
+            Read the file in a background thread, up to readahead blocks of
+            1MB ahead of decoding. This helps on slow or high-latency storage,
+            like network file systems. Defaults to 0, which disables it.
 
         Returns
         -------
         summary : np.ndarray
 
+        Raises
+        ------
+        ValueError
+            If column_type is not 'f4' or 'f8'
+
         Warnings
         --------
         This function is not stable and is likely to change in the future as
@@ -198,9 +226,22 @@ class summary(object):
         >>> report['TIME'][10:13]
         array([ 5.9388046,  8.035258 , 10.639209 ], dtype=float32)
         """
+        column_type = np.dtype(self.column_type)
+        if column_type not in (np.dtype('f4'), np.dtype('f8')):
+            msg = "column_type must be 'f4' or 'f8', was {}"
+            raise ValueError(msg.format(self.column_type))
+
         dtype = self.dtype
+        itemsize = column_type.itemsize
         alloc = lambda rows: np.empty(rows, dtype = dtype)
-        return core.readall(str(f), alloc, dtype.itemsize, self.pos)
+        return core.readall(
+            str(f),
+            alloc,
+            dtype.itemsize,
+            self.pos,
+            itemsize,
+            readahead,
+        )
 
     def update(self, key, values):
         """Update and set the attributes from a keyword
@@ -245,8 +286,13 @@ class summary(object):
         - XCOORD
         - YCOORD
         - TIMESTMP
+
+        values can be a list or a numpy array, like the ones from
+        core.stream.keywords. Strings may be str or bytes, and byte strings
+        are decoded as ASCII.
         """
         key = key.strip()
+        values = strings(values)
 
         if key == 'INTEHEAD':
             us = core.unitsystem(values[0])
@@ -403,6 +449,61 @@ class summary(object):
         self.index[key] = values
         return self
 
+    def assign(self, spec):
+        """Set the attributes from a parsed specification
+
+        Parameters
+        ----------
+        spec : dict
+            specification, as parsed by core.smspec
+
+        Notes
+        -----
+        This is the fast path of load, and does the same as calling update for
+        every keyword in the file, but most of the keywords are already
+        parsed. The index maps the parsed keywords to the attribute they set,
+        rather than to the raw values, except for DIMENS, which sets several
+        attributes, and is indexed with its raw values like in update.
+        """
+        attributes = {
+            'RESTART':  'restart',
+            'KEYWORDS': 'keywords',
+            'WGNAMES':  'wgnames',
+            'NAMES':    'names',
+            'NUMS':     'nums',
+            'LGRS':     'lgrs',
+            'NUMLX':    'numlx',
+            'NUMLY':    'numly',
+            'NUMLZ':    'numlz',
+            'LENGTHS':  'lengths',
+            'LENUNITS': 'lenunits',
+            'MEASRMNT': 'measurements',
+            'UNITS':    'units',
+            'LGRNAMES': 'lgrnames',
+            'LGRVEC':   'lgrvec',
+            'LGRTIMES': 'lgrtimes',
+            'STEPRESN': 'step_reason',
+            'XCOORD':   'xcoord',
+            'YCOORD':   'ycoord',
+        }
+
+        if spec['nlist'] is not None:
+            self.nlist = spec['nlist']
+            self.gridshape = spec['gridshape']
+            self.istar = spec['istar']
+            self.index['DIMENS'] = spec['dimens']
+
+        for key in spec['present']:
+            attr = attributes.get(key.strip())
+            if attr is not None:
+                setattr(self, attr, spec[attr])
+                self.index[key.strip()] = spec[attr]
+
+        for key, values in spec['update']:
+            self.update(key, values)
+
+        return self
+
     def check_integrity(self):
         """
         Verify that the minimum required data is set.
@@ -469,12 +570,30 @@ def load(path):
 
     Parameters
     ----------
-    path : str_like
-        path to a summary specification (.SMSPEC) file
+    path : str_like or bytes_like or io.BytesIO
+        path to a summary specification (.SMSPEC) file, which may be gzip or
+        zstd compressed, or the contents of one. In-memory contents, like
+        bytes, memoryview and io.BytesIO, are read without copying. bytes are
+        always contents, never a path, so pass paths as str or os.PathLike,
+        e.g. os.fsdecode(path).
 
     Returns
     -------
     summary : summary
+
+    Raises
+    ------
+    ValueError
+        If path is bytes that can not be the contents of a file, like a bytes
+        path
+
+    Examples
+    --------
+    Load a specification that is already in memory:
+
+    >>> with open('CASE.SMSPEC', 'rb') as f:
+    ...     spec = ecl3.summary.load(f.read())
     """
-    stream = core.stream(path)
-    return summary.load((k.keyword, k.values) for k in stream.keywords())
+    s = summary().assign(core.smspec(path))
+    s.check_integrity()
+    return s
@@ -3,6 +3,9 @@ from hypothesis import given
 from hypothesis import strategies as st
 import pytest
 import datetime
+import gzip
+import io
+import struct
 import numpy as np
 
 from .. import summary
@@ -207,8 +210,166 @@ def test_dtype_void_wgname():
     assert s.dtype == np.dtype(columns)
     assert s.pos == [0, 1]
 
+def test_dtype_blank_wgname():
+    keywords = {
+        'DIMENS':   [3, 1, 1, 1, 0, 0],
+        'KEYWORDS': ['WOPR', 'WOPT', 'WWCT'],
+        'WGNAMES':  ['W1', 'W2', '        '],
+        'UNITS':    ['SM3/DAY', 'SM3', ''],
+        'STARTDAT': [5, 3, 1971, 9, 37, 14917],
+        'NUMS':     [1, 1, 0],
+        'MEASRMNT': ['O:FLOWRA', 'TE      ', 'O:FLOWVO', 'LUME    ',
+                     'W:WATERC', 'UT      '],
+    }
+    s = summary.summary(keywords)
+    columns = [
+        ('REPORTSTEP', 'i4'), ('MINISTEP', 'i4'),
+        ('WOPR.W1', 'f4'), ('WOPT.W2', 'f4'), ('WWCT.', 'f4'),
+    ]
+    assert s.dtype == np.dtype(columns)
+    assert s.pos == [0, 1, 2]
+
 def test_load_smspec():
     s = summary.load(data / 'simple3.smspec')
     assert s.nlist == 687
     assert s.gridshape == (20, 20, 10)
     assert s.simulator == 'ECLIPSE 100'
+
+def test_stream_keywords_are_numpy_arrays():
+    stream = core.stream(data / 'simple3.smspec')
+    kws = {k.keyword: k.values for k in stream.keywords()}
+    dimens = kws['DIMENS  ']
+    assert isinstance(dimens, np.ndarray)
+    assert dimens.dtype == np.dtype('i4')
+    assert dimens[0] == 687
+
+    keywords = kws['KEYWORDS']
+    assert keywords.dtype == np.dtype('S8')
+    assert len(keywords) == 687
+
+def test_load_indexes_dimens_like_update():
+    stream = core.stream(data / 'simple3.smspec')
+    updated = summary.summary((k.keyword, k.values) for k in stream.keywords())
+    loaded = summary.load(data / 'simple3.smspec')
+    assert loaded.index['DIMENS'] == updated.index['DIMENS']
+    assert len(loaded.index['DIMENS']) == 6
+    assert loaded.index['DIMENS'][0] == 687
+
+def test_summary_from_stream_keywords():
+    stream = core.stream(data / 'simple3.smspec')
+    s = summary.summary((k.keyword, k.values) for k in stream.keywords())
+    s.check_integrity()
+    assert s.nlist == 687
+    assert s.keywords[:3] == ['TIME', 'YEARS', 'FOPR']
+    assert all(isinstance(x, str) for x in s.keywords)
+    assert s.measurements[0] == 'O:Simulation_Time'
+    assert s.restart == ''
+    assert s.lenunits == ' METRES '
+
+@pytest.mark.parametrize('column_type', ['i4', 'i8', 'f2', 'c8'])
+def test_readall_rejects_non_float_columns(column_type):
+    s = summary.summary(minimal_keywords)
+    s.column_type = column_type
+    with pytest.raises(ValueError):
+        s.readall('CASE.UNSMRY')
+
+def test_load_rejects_bytes_path():
+    with pytest.raises(ValueError) as e:
+        summary.load(b'/x/CASE.SMSPEC')
+    assert 'not as a path' in str(e.value)
+
+    with pytest.raises(ValueError):
+        core.stream(b'/x/CASE.SMSPEC')
+
+def smspec_bytes():
+    with open(str(data / 'simple3.smspec'), 'rb') as f:
+        return f.read()
+
+@pytest.mark.parametrize('wrap', [bytes, bytearray, memoryview, io.BytesIO])
+def test_load_smspec_from_memory(wrap):
+    s = summary.load(wrap(smspec_bytes()))
+    assert s.nlist == 687
+    assert s.gridshape == (20, 20, 10)
+    assert s.keywords[:3] == ['TIME', 'YEARS', 'FOPR']
+
+def write_unsmry(fname, params, steps = 1):
+    """Write a big-endian unified summary of steps report steps, each with one
+    ministep per row in params
+    """
+    def record(body):
+        marker = struct.pack('>i', len(body))
+        return marker + body + marker
+
+    def array(kw, kind, fmt, values):
+        head = kw.encode() + struct.pack('>i', len(values)) + kind.encode()
+        body = struct.pack('>{}{}'.format(len(values), fmt), *values)
+        return record(head) + record(body)
+
+    with open(fname, 'wb') as f:
+        for _ in range(steps):
+            f.write(array('SEQHDR  ', 'INTE', 'i', [0]))
+            for step, row in enumerate(params):
+                f.write(array('MINISTEP', 'INTE', 'i', [step]))
+                f.write(array('PARAMS  ', 'REAL', 'f', row))
+
+report_params = [[1.5, 2.5], [3.5, 4.5], [5.5, 6.5]]
+
+def check_report(report, column_type):
+    assert report.shape == (3,)
+    assert list(report['REPORTSTEP']) == [1, 1, 1]
+    assert list(report['MINISTEP']) == [0, 1, 2]
+    assert report['WOPR.W1'].dtype == np.dtype(column_type)
+    assert list(report['WOPR.W1']) == [1.5, 3.5, 5.5]
+    assert list(report['WOPT.W2']) == [2.5, 4.5, 6.5]
+
+@pytest.mark.parametrize('readahead', [0, 1, 4])
+def test_readall(tmpdir, readahead):
+    fname = str(tmpdir.join('CASE.UNSMRY'))
+    write_unsmry(fname, report_params)
+    s = summary.summary(minimal_keywords)
+    report = s.readall(fname, readahead = readahead)
+    assert report.dtype == s.dtype
+    check_report(report, 'f4')
+
+def test_readall_negative_readahead(tmpdir):
+    fname = str(tmpdir.join('CASE.UNSMRY'))
+    write_unsmry(fname, report_params)
+    s = summary.summary(minimal_keywords)
+    with pytest.raises(ValueError):
+        s.readall(fname, readahead = -1)
+
+def test_load_gzip_smspec(tmpdir):
+    fname = str(tmpdir.join('CASE.SMSPEC.gz'))
+    with gzip.open(fname, 'wb') as f:
+        f.write(smspec_bytes())
+
+    s = summary.load(fname)
+    assert s.nlist == 687
+    assert s.keywords[:3] == ['TIME', 'YEARS', 'FOPR']
+
+def test_readall_gzip(tmpdir):
+    fname = str(tmpdir.join('CASE.UNSMRY'))
+    write_unsmry(fname, report_params)
+    with open(fname, 'rb') as src, gzip.open(fname + '.gz', 'wb') as dst:
+        dst.write(src.read())
+
+    s = summary.summary(minimal_keywords)
+    check_report(s.readall(fname + '.gz'), 'f4')
+    check_report(s.readall(fname + '.gz', readahead = 2), 'f4')
+
+def test_readall_f8_columns(tmpdir):
+    fname = str(tmpdir.join('CASE.UNSMRY'))
+    write_unsmry(fname, report_params)
+    s = summary.summary(minimal_keywords)
+    s.column_type = 'f8'
+    check_report(s.readall(fname), 'f8')
+
+@pytest.mark.parametrize('steps', [2, 4, 40])
+def test_readall_several_report_steps(tmpdir, steps):
+    fname = str(tmpdir.join('CASE.UNSMRY'))
+    write_unsmry(fname, report_params, steps = steps)
+    s = summary.summary(minimal_keywords)
+    report = s.readall(fname)
+    assert report.shape == (3 * steps,)
+    assert list(report['MINISTEP']) == [0, 1, 2] * steps
+    assert list(report['WOPT.W2']) == [2.5, 4.5, 6.5] * steps